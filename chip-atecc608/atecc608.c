@@ -6,13 +6,31 @@
 
 #include "wokwi-api.h"
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <time.h>
 
-#define ATECC608_ADDR 0xC0 >> 1  // 7-bit I2C address
+#if !defined(ATECC608_PORTABLE_CRYPTO)
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define SHA256_X86_NI
+#define AES_X86_NI
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_AES))
+#include <arm_neon.h>
+#if defined(__ARM_FEATURE_SHA2)
+#define SHA256_ARMV8
+#endif
+#if defined(__ARM_FEATURE_AES)
+#define AES_ARMV8
+#endif
+#endif
+#endif
+
+#define ATECC608_ADDR (0xC0 >> 1)  // 7-bit I2C address
 
 // ATECC608 Commands
 #define CMD_RESET 0x00
@@ -28,6 +46,13 @@
 #define CMD_WRITE 0x12
 #define CMD_LOCK 0x17
 #define CMD_INFO 0x30
+#define CMD_SHA 0x47
+#define CMD_ECDH 0x43
+#define CMD_KDF 0x56
+#define CMD_AES 0x51
+#define CMD_COUNTER 0x24
+#define CMD_SECUREBOOT 0x80
+#define CMD_SELFTEST 0x77
 
 // Zones
 #define ZONE_CONFIG 0x00
@@ -38,314 +63,4168 @@
 #define KEY_TYPE_P256 0x04
 #define KEY_TYPE_AES 0x06
 
+// Command modes (param1)
+#define NONCE_MODE_MASK 0x03
+#define NONCE_MODE_SEED_UPDATE 0x00
+#define NONCE_MODE_NO_SEED_UPDATE 0x01
+#define NONCE_MODE_PASSTHROUGH 0x03
+#define NONCE_MODE_INPUT_64 0x20
+#define NONCE_MODE_TARGET_MASK 0xC0
+#define NONCE_MODE_TARGET_TEMPKEY 0x00
+#define NONCE_MODE_TARGET_MSGDIGBUF 0x40
+#define NONCE_MODE_TARGET_ALTKEYBUF 0x80
+#define GENKEY_MODE_PRIVATE 0x04
+#define SIGN_MODE_EXTERNAL 0x80
+#define MESSAGE_SOURCE_MSGDIGBUF 0x20  // Sign and Verify: message from MsgDigBuf
+#define VERIFY_MODE_MASK 0x03
+#define VERIFY_MODE_STORED 0x00
+#define VERIFY_MODE_EXTERNAL 0x02
+#define ECDH_MODE_SOURCE_TEMPKEY 0x01
+#define ECDH_MODE_OUTPUT_ENCRYPTED 0x02
+#define ECDH_MODE_COPY_MASK 0x0C
+#define ECDH_MODE_COPY_COMPATIBLE 0x00
+#define ECDH_MODE_COPY_SLOT 0x04
+#define ECDH_MODE_COPY_TEMPKEY 0x08
+#define ECDH_MODE_COPY_OUTPUT_BUFFER 0x0C
+#define KDF_MODE_SOURCE_MASK 0x03
+#define KDF_MODE_SOURCE_TEMPKEY 0x00
+#define KDF_MODE_SOURCE_TEMPKEY_UP 0x01
+#define KDF_MODE_SOURCE_SLOT 0x02
+#define KDF_MODE_SOURCE_ALTKEYBUF 0x03
+#define KDF_MODE_TARGET_MASK 0x1C
+#define KDF_MODE_TARGET_TEMPKEY 0x00
+#define KDF_MODE_TARGET_TEMPKEY_UP 0x04
+#define KDF_MODE_TARGET_SLOT 0x08
+#define KDF_MODE_TARGET_ALTKEYBUF 0x0C
+#define KDF_MODE_TARGET_OUTPUT 0x10
+#define KDF_MODE_TARGET_OUTPUT_ENC 0x14
+#define KDF_MODE_ALG_MASK 0x60
+#define KDF_MODE_ALG_PRF 0x00
+#define KDF_MODE_ALG_AES 0x20
+#define KDF_MODE_ALG_HKDF 0x40
+#define KDF_DETAILS_PRF_KEY_LEN_MASK 0x03
+#define KDF_DETAILS_PRF_TARGET_LEN_64 0x100
+#define KDF_DETAILS_AES_KEY_LOC_MASK 0x03
+#define KDF_DETAILS_HKDF_MSG_LOC_MASK 0x03
+#define KDF_DETAILS_HKDF_MSG_LOC_SLOT 0x00
+#define KDF_DETAILS_HKDF_MSG_LOC_TEMPKEY 0x01
+#define KDF_DETAILS_HKDF_MSG_LOC_INPUT 0x02
+#define KDF_DETAILS_HKDF_ZERO_KEY 0x04
+#define AES_MODE_OP_MASK 0x07
+#define AES_MODE_ENCRYPT 0x00
+#define AES_MODE_DECRYPT 0x01
+#define AES_MODE_GFM 0x03
+#define AES_MODE_KEY_BLOCK_SHIFT 6
+#define AES_KEY_BLOCKS 4  // Key blocks the mode field can select
+#define AES_KEY_ID_TEMPKEY 0xFFFF
+#define COUNTER_MODE_READ 0x00
+#define COUNTER_MODE_INCREMENT 0x01
+#define SECUREBOOT_MODE_MASK 0x07
+#define SECUREBOOT_MODE_FULL 0x05
+#define SECUREBOOT_MODE_FULL_STORE 0x06
+#define INFO_MODE_REVISION 0x00
+#define INFO_MODE_KEY_VALID 0x01
+#define INFO_MODE_STATE 0x02
+#define INFO_MODE_GPIO 0x03
+#define INFO_GPIO_SET_LATCH 0x0002  // param2: drive the latch to bit 0
+#define SELFTEST_MODE_RNG 0x01
+#define SELFTEST_MODE_ECDSA 0x02  // Sign and verify
+#define SELFTEST_MODE_ECDH 0x08
+#define SELFTEST_MODE_AES 0x10
+#define SELFTEST_MODE_SHA 0x20
+#define SELFTEST_MODE_ALL 0x3B
+#define SHA_MODE_MASK 0x07
+#define SHA_MODE_START 0x00
+#define SHA_MODE_UPDATE 0x01
+#define SHA_MODE_END 0x02
+#define SHA_MODE_HMAC_START 0x04
+#define SHA_MODE_HMAC_END 0x05
+
+// What the SHA command's context is currently computing
+#define SHA_CONTEXT_NONE 0
+#define SHA_CONTEXT_SHA 1
+#define SHA_CONTEXT_HMAC 2
+
+// Status codes returned in a 4-byte response packet
+#define STATUS_SUCCESS 0x00
+#define STATUS_VERIFY_FAILED 0x01
+#define STATUS_PARSE_ERROR 0x03
+#define STATUS_WAKE 0x11
+#define STATUS_EXECUTION_ERROR 0x0F
+#define STATUS_CRC_ERROR 0xFF
+
 #define CONFIG_SIZE 128
 #define OTP_SIZE 64
-#define DATA_SIZE 1024
-#define MAX_PACKET_SIZE 128
+#define DATA_SIZE 1216  // Largest variant data zone in whole 32-byte blocks, see chipVariants
+// EEPROM image file: config, OTP and the variant's data zone back to back, in
+// 32-byte blocks. EEPROM_BLOCKS is the most any variant uses.
+#define EEPROM_BLOCK_SIZE 32
+#define EEPROM_CONFIG_BLOCK 0
+#define EEPROM_OTP_BLOCK (CONFIG_SIZE / EEPROM_BLOCK_SIZE)
+#define EEPROM_DATA_BLOCK (EEPROM_OTP_BLOCK + OTP_SIZE / EEPROM_BLOCK_SIZE)
+#define EEPROM_BLOCKS (EEPROM_DATA_BLOCK + DATA_SIZE / EEPROM_BLOCK_SIZE)
+#define EEPROM_SIZE (EEPROM_BLOCKS * EEPROM_BLOCK_SIZE)
 
-typedef enum {
-    IDLE,
-    SLEEP,
-    ACTIVE
-} DeviceState;
+// Monotonic counters. Each one owns 8 config bytes from COUNTER_OFFSET,
+// packed as its 21-bit value and the number of increments it has taken,
+// both u32 little-endian. Increments are counted as spread evenly over
+// those 8 bytes, as the chip's encoding does, when reporting wear.
+#define COUNTER_COUNT 2
+#define COUNTER_OFFSET 52
+#define COUNTER_MAX 0x1FFFFF
+#define COUNTER_WEAR_CELLS 8
+#define EEPROM_ENDURANCE 400000  // Write cycles per byte, datasheet minimum
+
+// SecureBoot config, bytes 70-71: the mode in bits 1-0, then the slot that
+// holds the stored digest or signature in bits 11-8 and the public key slot
+// in bits 15-12
+#define SECUREBOOT_CONFIG_OFFSET 70
+#define SECUREBOOT_CONFIG_MODE_MASK 0x03
+#define SECUREBOOT_CONFIG_DISABLED 0x00
+#define SECUREBOOT_CONFIG_FULL_BOTH 0x01  // Host sends digest and signature every boot
+#define SECUREBOOT_CONFIG_FULL_SIG 0x02   // Signature stored, host sends the digest
+#define SECUREBOOT_CONFIG_FULL_DIG 0x03   // Digest stored, host sends the digest
+
+#define MAX_PACKET_SIZE 152  // Largest command (Verify external) is 135 bytes
+
+// Power states. SDA must stay low for WAKE_LOW_NS to wake the chip, which
+// then needs the "wakeDelay" attribute's worth of microseconds before it
+// answers. The watchdog sends it back to sleep "watchdogTimeout" ms after
+// every wake.
+#define WAKE_LOW_NS 60000            // tWLO
+#define WAKE_DELAY_DEFAULT 1500      // tWHI, us
+#define WATCHDOG_TIMEOUT_DEFAULT 1300  // ms
+
+// CRC-16 used on the I2C interface: polynomial 0x8005, data bits are fed
+// LSB first, initial value 0, and the result is sent low byte first.
+// The running state is kept bit-reflected so every byte is a single table
+// lookup; crc_final() turns it back into the value seen on the wire.
+#define CRC_INIT 0x0000
+
+static const uint16_t crcTable[256] = {
+    0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+    0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+    0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+    0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+    0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+    0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+    0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+    0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+    0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+    0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+    0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+    0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+    0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+    0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+    0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+    0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+    0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+    0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+    0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+    0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+    0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+    0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+    0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+    0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+    0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+    0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+    0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+    0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+    0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+    0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+    0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+    0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040,
+};
+
+static inline uint16_t crc_update(uint16_t state, uint8_t byte) {
+    return (state >> 8) ^ crcTable[(uint8_t)(state ^ byte)];
+}
+
+static inline uint16_t crc_final(uint16_t state) {
+    state = ((state >> 1) & 0x5555) | ((state & 0x5555) << 1);
+    state = ((state >> 2) & 0x3333) | ((state & 0x3333) << 2);
+    state = ((state >> 4) & 0x0F0F) | ((state & 0x0F0F) << 4);
+    return (state >> 8) | (state << 8);
+}
+
+// Little-endian 32-bit words: KDF details, the counters, the trace header
+// and the AES state columns
+static inline uint32_t loadLe32(const uint8_t *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline void storeLe32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+// Latency profiles, selected with the "latencyProfile" attribute
+#define LATENCY_TYPICAL 0
+#define LATENCY_MAX 1
+#define LATENCY_ZERO 2
+#define LATENCY_DEFAULT 0xFFFFFFFF  // Override attribute not set
+
+// One latency slot per opcode, referenced from the command table
+enum {
+    LAT_RANDOM,
+    LAT_NONCE,
+    LAT_GENKEY,
+    LAT_SIGN,
+    LAT_VERIFY,
+    LAT_READ,
+    LAT_WRITE,
+    LAT_LOCK,
+    LAT_INFO,
+    LAT_SHA,
+    LAT_ECDH,
+    LAT_KDF,
+    LAT_AES,
+    LAT_COUNTER,
+    LAT_SECUREBOOT,
+    LAT_SELFTEST,
+    LATENCY_ENTRIES
+};
 
 typedef struct {
-    DeviceState state;
-    uint8_t lastError;
-    uint8_t configZone[CONFIG_SIZE];
-    uint8_t otpZone[OTP_SIZE];
-    uint8_t dataZone[DATA_SIZE];
-    uint8_t commandPacket[MAX_PACKET_SIZE];
-    uint8_t responsePacket[MAX_PACKET_SIZE];
-    uint8_t packetPos;
-    uint8_t responsePos;
-    uint32_t executionTime;
-} ATECC608;
+    const char *name;  // Command name in the stats dump
+    const char *attr;  // Per-opcode override, in ms
+    uint16_t typical;  // ms
+    uint16_t max;      // ms
+} LatencyEntry;
 
-static ATECC608 device;
+static const LatencyEntry latencyTable[LATENCY_ENTRIES] = {
+    [LAT_RANDOM] = { "Random", "latencyRandom", 23, 23 },
+    [LAT_NONCE] = { "Nonce", "latencyNonce", 7, 20 },
+    [LAT_GENKEY] = { "GenKey", "latencyGenKey", 115, 215 },
+    [LAT_SIGN] = { "Sign", "latencySign", 60, 115 },
+    [LAT_VERIFY] = { "Verify", "latencyVerify", 72, 105 },
+    [LAT_READ] = { "Read", "latencyRead", 1, 5 },
+    [LAT_WRITE] = { "Write", "latencyWrite", 26, 45 },
+    [LAT_LOCK] = { "Lock", "latencyLock", 32, 35 },
+    [LAT_INFO] = { "Info", "latencyInfo", 1, 5 },
+    [LAT_SHA] = { "SHA", "latencySha", 7, 36 },
+    [LAT_ECDH] = { "ECDH", "latencyEcdh", 38, 58 },
+    [LAT_KDF] = { "KDF", "latencyKdf", 16, 40 },
+    [LAT_AES] = { "AES", "latencyAes", 1, 27 },
+    [LAT_COUNTER] = { "Counter", "latencyCounter", 7, 20 },
+    [LAT_SECUREBOOT] = { "SecureBoot", "latencySecureBoot", 72, 105 },
+    [LAT_SELFTEST] = { "SelfTest", "latencySelfTest", 200, 625 },
+};
 
-// Function prototypes
-static void generateRandomNumber(uint8_t *random, uint8_t length);
-static uint16_t calculateCRC(const uint8_t *data, size_t length);
-static void processCommand(void);
-static bool sendCommand(uint8_t command, uint8_t p1, uint16_t p2, const uint8_t *data, uint8_t dataLen);
-static void simulateSignature(const uint8_t *message, uint8_t *signature);
-static bool simulateVerification(const uint8_t *message, const uint8_t *signature);
-static bool read(uint8_t zone, uint16_t address, uint8_t *data, uint8_t len);
-static bool write(uint8_t zone, uint16_t address, const uint8_t *data, uint8_t len);
-static bool lockConfigZone(void);
-static bool lockDataAndOTPZones(void);
-static bool isConfigLocked(void);
-static bool isDataAndOTPLocked(void);
-static bool storeKey(uint8_t key_id, const uint8_t *key, uint8_t key_type);
-static bool generatePrivateKey(uint8_t key_id, uint8_t key_type);
-static bool computeHMAC(uint8_t key_id, const uint8_t *message, uint8_t *hmac);
-static bool deriveKey(uint8_t parent_key_id, uint8_t *derived_key);
-static void simulateExecutionTime(uint32_t duration);
-static void setResponse(uint8_t *data, uint8_t len);
-
-void atecc608_init(void) {
-    device.state = IDLE;
-    device.lastError = 0;
-    device.packetPos = 0;
-    device.responsePos = 0;
-    device.executionTime = 0;
-    memset(device.configZone, 0xFF, CONFIG_SIZE);
-    memset(device.otpZone, 0, OTP_SIZE);
-    memset(device.dataZone, 0, DATA_SIZE);
-    
-    // Initialize config zone with some default values
-    device.configZone[0] = 0x01; // I2C address
-    device.configZone[1] = 0x23; // Chip mode
-    // More config initialization can be added here
+// Host-side cost accounting, one CommandStats per latency slot. Host time is
+// bucketed by log2 of the nanoseconds a handler took.
+#define STATS_BUCKETS 32
 
-    // Seed the random number generator
-    srand(time(NULL));
+typedef struct {
+    uint32_t calls;
+    uint32_t errors;   // Status responses other than success
+    uint64_t busyMs;   // Simulated execution time
+    uint64_t hostNs;   // Host CPU time spent in the handler
+    uint32_t histogram[STATS_BUCKETS];
+} CommandStats;
+
+typedef struct {
+    CommandStats command[LATENCY_ENTRIES];
+    uint32_t connects;
+    uint32_t busyNacks;   // Address polls while a command was executing
+    uint32_t sleepNacks;  // Address polls while asleep, idle or waking
+    uint32_t wakes;
+    uint32_t watchdogSleeps;
+    uint32_t crcErrors;
+    uint32_t rejected;    // Unknown opcode, bad length or wrong lock state
+    uint32_t secureBootHits;  // SecureBoot signatures found in the cache
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+} DeviceStats;
+
+// Lock states a command may run in, see CommandDescriptor.allowedStates
+#define LOCK_STATE_UNLOCKED 0x01       // Config zone unlocked
+#define LOCK_STATE_CONFIG_LOCKED 0x02  // Config locked, data and OTP unlocked
+#define LOCK_STATE_LOCKED 0x04         // Everything locked
+#define LOCK_STATE_ANY 0x07
+
+// SHA-256. The block function dispatches to SHA-NI or the ARMv8 SHA2
+// instructions when the host has them, otherwise to the portable rounds.
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;  // Bytes hashed so far
+    uint8_t block[64];
+    uint8_t blockLen;
+} Sha256Context;
+
+typedef struct {
+    Sha256Context inner;
+    Sha256Context outer;
+} HmacSha256Context;
+
+static const uint32_t sha256K[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+static const uint32_t sha256IV[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256CompressPortable(uint32_t *state, const uint8_t *data, size_t blocks) {
+    while (blocks--) {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t)data[4 * i] << 24 | (uint32_t)data[4 * i + 1] << 16 |
+                   (uint32_t)data[4 * i + 2] << 8 | data[4 * i + 3];
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = ROTR32(w[i - 15], 7) ^ ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = ROTR32(w[i - 2], 17) ^ ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) +
+                          ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+            uint32_t t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) +
+                          ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+        data += 64;
+    }
 }
 
-static void generateRandomNumber(uint8_t *random, uint8_t length) {
-    for (uint8_t i = 0; i < length; i++) {
-        random[i] = rand() & 0xFF;
+#if defined(SHA256_X86_NI)
+__attribute__((target("sha,sse4.1")))
+static void sha256CompressShaNi(uint32_t *state, const uint8_t *data, size_t blocks) {
+    const __m128i byteswap = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+
+    // The instructions want the state as ABEF / CDGH
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    while (blocks--) {
+        __m128i abef = state0, cdgh = state1;
+        __m128i msg[4];
+        for (int i = 0; i < 16; i++) {
+            __m128i w;
+            if (i < 4) {
+                w = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * i)), byteswap);
+            } else {
+                w = _mm_sha256msg1_epu32(msg[i & 3], msg[(i + 1) & 3]);
+                w = _mm_add_epi32(w, _mm_alignr_epi8(msg[(i + 3) & 3], msg[(i + 2) & 3], 4));
+                w = _mm_sha256msg2_epu32(w, msg[(i + 3) & 3]);
+            }
+            msg[i & 3] = w;
+
+            __m128i wk = _mm_add_epi32(w, _mm_loadu_si128((const __m128i *)&sha256K[4 * i]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+        }
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+        data += 64;
     }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i *)&state[0], state0);
+    _mm_storeu_si128((__m128i *)&state[4], state1);
 }
 
-static uint16_t calculateCRC(const uint8_t *data, size_t length) {
-    uint16_t crc = 0;
-    uint8_t counter;
-    uint16_t crc_register;
-    uint16_t polynom = 0x8005;
-    
-    for (counter = 0; counter < length; counter++) {
-        crc_register = (uint8_t)(crc >> 8) | (crc << 8);
-        crc_register ^= data[counter];
-        crc_register ^= (uint8_t)(crc_register & 0xff) >> 4;
-        crc_register ^= (crc_register << 8) << 4;
-        crc_register ^= ((crc_register & 0xff) << 4) << 1;
-        crc = crc_register;
-    }
-    
-    return crc;
-}
-
-static void processCommand(void) {
-    uint8_t command = device.commandPacket[2];
-    uint8_t p1 = device.commandPacket[3];
-    uint16_t p2 = (device.commandPacket[5] << 8) | device.commandPacket[4];
-    
-    switch (command) {
-        case CMD_RANDOM:
-            generateRandomNumber(device.responsePacket + 1, 32);
-            setResponse(device.responsePacket, 33);
-            simulateExecutionTime(23);  // Typical execution time in ms
-            break;
-        case CMD_NONCE:
-            // Implement nonce generation
-            simulateExecutionTime(7);  // Typical execution time in ms
-            break;
-        case CMD_GENKEY:
-            // Implement key generation
-            simulateExecutionTime(115);  // Typical execution time in ms
-            break;
-        case CMD_SIGN:
-            // Implement signing
-            simulateExecutionTime(60);  // Typical execution time in ms
-            break;
-        case CMD_VERIFY:
-            // Implement verification
-            simulateExecutionTime(72);  // Typical execution time in ms
-            break;
-        case CMD_READ:
-            // Implement read operation
-            simulateExecutionTime(1);  // Typical execution time in ms
-            break;
-        case CMD_WRITE:
-            // Implement write operation
-            simulateExecutionTime(26);  // Typical execution time in ms
-            break;
-        case CMD_LOCK:
-            // Implement lock operation
-            simulateExecutionTime(32);  // Typical execution time in ms
-            break;
-        case CMD_INFO:
-            // Implement info command
-            simulateExecutionTime(1);  // Typical execution time in ms
-            break;
-        default:
-            device.lastError = 7;
-            break;
+static bool hostHasShaNi(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_1)) {
+        return false;
+    }
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return false;
     }
+    return ebx & (1u << 29);
 }
+#endif
+
+#if defined(SHA256_ARMV8)
+static void sha256CompressArmv8(uint32_t *state, const uint8_t *data, size_t blocks) {
+    uint32x4_t state0 = vld1q_u32(&state[0]);
+    uint32x4_t state1 = vld1q_u32(&state[4]);
+
+    while (blocks--) {
+        uint32x4_t abcd = state0, efgh = state1;
+        uint32x4_t msg[4];
+        for (int i = 0; i < 16; i++) {
+            uint32x4_t w;
+            if (i < 4) {
+                w = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+            } else {
+                w = vsha256su0q_u32(msg[i & 3], msg[(i + 1) & 3]);
+                w = vsha256su1q_u32(w, msg[(i + 2) & 3], msg[(i + 3) & 3]);
+            }
+            msg[i & 3] = w;
+
+            uint32x4_t wk = vaddq_u32(w, vld1q_u32(&sha256K[4 * i]));
+            uint32x4_t prev = state0;
+            state0 = vsha256hq_u32(state0, state1, wk);
+            state1 = vsha256h2q_u32(state1, prev, wk);
+        }
+        state0 = vaddq_u32(state0, abcd);
+        state1 = vaddq_u32(state1, efgh);
+        data += 64;
+    }
+
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+#endif
+
+static void (*sha256Compress)(uint32_t *state, const uint8_t *data, size_t blocks);
 
-uint8_t atecc608_read_byte(void) {
-    if (device.responsePos < MAX_PACKET_SIZE) {
-        return device.responsePacket[device.responsePos++];
+static void sha256SelectEngine(void) {
+    sha256Compress = sha256CompressPortable;
+#if defined(SHA256_X86_NI)
+    if (hostHasShaNi()) {
+        sha256Compress = sha256CompressShaNi;
     }
-    return 0;
+#elif defined(SHA256_ARMV8)
+    sha256Compress = sha256CompressArmv8;
+#endif
 }
 
-void atecc608_write_byte(uint8_t byte) {
-    if (device.packetPos < MAX_PACKET_SIZE) {
-        device.commandPacket[device.packetPos++] = byte;
+static void sha256Init(Sha256Context *ctx) {
+    if (!sha256Compress) {
+        sha256SelectEngine();
     }
-    if (device.packetPos == 1) {  // Word Address
-        if (byte == 0x03) {  // Command packet
-            device.packetPos = 0;  // Reset for actual command
+    memcpy(ctx->state, sha256IV, sizeof(ctx->state));
+    ctx->length = 0;
+    ctx->blockLen = 0;
+}
+
+static void sha256Update(Sha256Context *ctx, const uint8_t *data, size_t len) {
+    ctx->length += len;
+    if (ctx->blockLen) {
+        size_t take = 64 - ctx->blockLen;
+        if (take > len) {
+            take = len;
         }
-    } else if (device.packetPos > 1 && device.commandPacket[0] == CMD_COMMAND) {
-        if (device.packetPos == device.commandPacket[1]) {  // Received all bytes
-            processCommand();
-            device.packetPos = 0;
+        memcpy(ctx->block + ctx->blockLen, data, take);
+        ctx->blockLen += take;
+        data += take;
+        len -= take;
+        if (ctx->blockLen < 64) {
+            return;
         }
+        sha256Compress(ctx->state, ctx->block, 1);
+        ctx->blockLen = 0;
     }
+    if (len >= 64) {
+        sha256Compress(ctx->state, data, len / 64);
+        data += len & ~(size_t)63;
+        len &= 63;
+    }
+    memcpy(ctx->block, data, len);
+    ctx->blockLen = len;
 }
 
-static bool sendCommand(uint8_t command, uint8_t p1, uint16_t p2, const uint8_t *data, uint8_t dataLen) {
-    uint8_t count = 7 + dataLen;
-    device.commandPacket[0] = CMD_COMMAND;
-    device.commandPacket[1] = count;
-    device.commandPacket[2] = command;
-    device.commandPacket[3] = p1;
-    device.commandPacket[4] = p2 & 0xFF;
-    device.commandPacket[5] = p2 >> 8;
-    if (data && dataLen > 0) {
-        memcpy(&device.commandPacket[6], data, dataLen);
+static inline void sha256UpdateByte(Sha256Context *ctx, uint8_t byte) {
+    ctx->block[ctx->blockLen++] = byte;
+    ctx->length++;
+    if (ctx->blockLen == 64) {
+        sha256Compress(ctx->state, ctx->block, 1);
+        ctx->blockLen = 0;
     }
-    device.commandPacket[count - 1] = calculateCRC(&device.commandPacket[1], count - 2);
-    
-    processCommand();
-    return true;
 }
 
-static void simulateSignature(const uint8_t *message, uint8_t *signature) {
-    for (uint8_t i = 0; i < 64; i++) {
-        signature[i] = message[i % 32] ^ (rand() & 0xFF);
+static void sha256Final(Sha256Context *ctx, uint8_t *digest) {
+    uint64_t bits = ctx->length * 8;
+    uint8_t pad[72] = { 0x80 };
+    size_t padLen = (ctx->blockLen < 56 ? 56 : 120) - ctx->blockLen;
+    for (int i = 0; i < 8; i++) {
+        pad[padLen + i] = bits >> (56 - 8 * i);
+    }
+    sha256Update(ctx, pad, padLen + 8);
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = ctx->state[i] >> 24;
+        digest[4 * i + 1] = ctx->state[i] >> 16;
+        digest[4 * i + 2] = ctx->state[i] >> 8;
+        digest[4 * i + 3] = ctx->state[i];
     }
 }
 
-static bool simulateVerification(const uint8_t *message, const uint8_t *signature) {
-    return true;
+static void sha256(const uint8_t *data, size_t len, uint8_t *digest) {
+    Sha256Context ctx;
+    sha256Init(&ctx);
+    sha256Update(&ctx, data, len);
+    sha256Final(&ctx, digest);
 }
 
-static bool read(uint8_t zone, uint16_t address, uint8_t *data, uint8_t len) {
-    if (len > 32) {
-        device.lastError = 1;
-        return false;
+// HMAC-SHA256. Both padded key blocks are absorbed up front, so a context
+// that has only been through hmacSha256Init() can be copied and reused for
+// any number of messages under the same key.
+static void hmacSha256Init(HmacSha256Context *ctx, const uint8_t *key, size_t keyLen) {
+    uint8_t pad[64] = { 0 };
+    if (keyLen > 64) {
+        sha256(key, keyLen, pad);
+    } else {
+        memcpy(pad, key, keyLen);
     }
-    uint8_t *source;
-    uint16_t max_len;
-    switch (zone & 0x03) {
-        case ZONE_CONFIG: source = device.configZone; max_len = CONFIG_SIZE; break;
-        case ZONE_OTP: source = device.otpZone; max_len = OTP_SIZE; break;
-        case ZONE_DATA: source = device.dataZone; max_len = DATA_SIZE; break;
-        default: device.lastError = 2; return false;
+    for (int i = 0; i < 64; i++) {
+        pad[i] ^= 0x36;
     }
-    if (address + len > max_len) {
-        device.lastError = 3;
-        return false;
+    sha256Init(&ctx->inner);
+    sha256Update(&ctx->inner, pad, 64);
+    for (int i = 0; i < 64; i++) {
+        pad[i] ^= 0x36 ^ 0x5C;
     }
-    memcpy(data, source + address, len);
-    return true;
+    sha256Init(&ctx->outer);
+    sha256Update(&ctx->outer, pad, 64);
 }
 
-static bool write(uint8_t zone, uint16_t address, const uint8_t *data, uint8_t len) {
-    if (len > 32) {
-        device.lastError = 1;
-        return false;
-    }
-    uint8_t *dest;
-    uint16_t max_len;
-    switch (zone & 0x03) {
-        case ZONE_CONFIG: dest = device.configZone; max_len = CONFIG_SIZE; break;
-        case ZONE_OTP: dest = device.otpZone; max_len = OTP_SIZE; break;
-        case ZONE_DATA: dest = device.dataZone; max_len = DATA_SIZE; break;
-        default: device.lastError = 2; return false;
+static void hmacSha256Update(HmacSha256Context *ctx, const uint8_t *data, size_t len) {
+    sha256Update(&ctx->inner, data, len);
+}
+
+static void hmacSha256Final(HmacSha256Context *ctx, uint8_t *mac) {
+    uint8_t inner[32];
+    sha256Final(&ctx->inner, inner);
+    sha256Update(&ctx->outer, inner, 32);
+    sha256Final(&ctx->outer, mac);
+}
+
+// AES-128. Blocks go through AES-NI or the ARMv8 AES instructions when the
+// host has them. The portable fallback is constant time: the S-box is
+// computed as x^254 in GF(2^8) followed by the affine map, four bytes at a
+// time in a 32-bit word, so no lookup depends on key or data.
+typedef struct {
+    uint32_t rk[44];     // Round keys as little-endian columns
+    uint8_t dk[11][16];  // Inverse-cipher round keys, hardware engines only
+} Aes128Key;
+
+#define AES_LO_BITS 0x7F7F7F7Fu
+#define AES_HI_BITS 0x80808080u
+#define AES_LSB 0x01010101u
+
+static inline uint32_t aesXtime(uint32_t x) {
+    return ((x & AES_LO_BITS) << 1) ^ (((x & AES_HI_BITS) >> 7) * 0x1B);
+}
+
+// Bytewise GF(2^8) product of two packed words
+static uint32_t aesMul(uint32_t a, uint32_t b) {
+    uint32_t r = 0;
+    for (int i = 0; i < 8; i++) {
+        r ^= a & (((b >> i) & AES_LSB) * 0xFF);
+        a = aesXtime(a);
     }
-    if (address + len > max_len) {
-        device.lastError = 3;
-        return false;
+    return r;
+}
+
+static inline uint32_t aesRotByte(uint32_t x, int n) {
+    uint32_t hi = (0xFFu << n) & 0xFF;
+    return ((x << n) & (hi * AES_LSB)) | ((x >> (8 - n)) & ((~hi & 0xFF) * AES_LSB));
+}
+
+static uint32_t aesInvert(uint32_t x) {
+    uint32_t x2 = aesMul(x, x);
+    uint32_t x3 = aesMul(x2, x);
+    uint32_t x12 = aesMul(x3, x3);
+    x12 = aesMul(x12, x12);
+    uint32_t x15 = aesMul(x12, x3);
+    uint32_t x240 = x15;
+    for (int i = 0; i < 4; i++) {
+        x240 = aesMul(x240, x240);
     }
-    memcpy(dest + address, data, len);
-    return true;
+    return aesMul(aesMul(x240, x12), x2);  // x^254
 }
 
-static bool lockConfigZone(void) {
-    device.configZone[87] = 0x00;  // Set the lock byte
-    return true;
+static uint32_t aesSubWord(uint32_t x) {
+    uint32_t inv = aesInvert(x);
+    return inv ^ aesRotByte(inv, 1) ^ aesRotByte(inv, 2) ^ aesRotByte(inv, 3) ^
+           aesRotByte(inv, 4) ^ 0x63636363u;
 }
 
-static bool lockDataAndOTPZones(void) {
-    device.configZone[86] = 0x00;  // Set the lock byte
-    return true;
+static uint32_t aesInvSubWord(uint32_t x) {
+    return aesInvert(aesRotByte(x, 1) ^ aesRotByte(x, 3) ^ aesRotByte(x, 6) ^ 0x05050505u);
 }
 
-static bool isConfigLocked(void) {
-    return device.configZone[87] == 0x00;
+static inline uint32_t aesMixColumn(uint32_t w) {
+    uint32_t r8 = (w >> 8) | (w << 24);
+    uint32_t r16 = (w >> 16) | (w << 16);
+    uint32_t r24 = (w >> 24) | (w << 8);
+    return aesXtime(w ^ r8) ^ r8 ^ r16 ^ r24;
 }
 
-static bool isDataAndOTPLocked(void) {
-    return device.configZone[86] == 0x00;
+// InvMixColumns is MixColumns after adding 4 * (a[i] ^ a[i + 2]) to each byte
+static inline uint32_t aesInvMixColumn(uint32_t w) {
+    uint32_t r16 = (w >> 16) | (w << 16);
+    return aesMixColumn(w ^ aesXtime(aesXtime(w ^ r16)));
 }
 
-static bool storeKey(uint8_t key_id, const uint8_t *key, uint8_t key_type) {
-    if (key_id >= 16) {
-        device.lastError = 8;
-        return false;
+static void aesSelectEngine(void);
+static void (*aesPrepareDecrypt)(Aes128Key *key);
+
+static void aes128ExpandKey(Aes128Key *key, const uint8_t *k) {
+    if (!aesPrepareDecrypt) {
+        aesSelectEngine();
+    }
+    uint32_t rcon = 0x01;
+    for (int i = 0; i < 4; i++) {
+        key->rk[i] = loadLe32(k + 4 * i);
+    }
+    for (int i = 4; i < 44; i++) {
+        uint32_t t = key->rk[i - 1];
+        if (i % 4 == 0) {
+            t = aesSubWord((t >> 8) | (t << 24)) ^ rcon;
+            rcon = aesXtime(rcon);
+        }
+        key->rk[i] = key->rk[i - 4] ^ t;
     }
-    uint16_t address = 32 * key_id;
-    return write(ZONE_DATA, address, key, 32);
+    aesPrepareDecrypt(key);
 }
 
-static bool generatePrivateKey(uint8_t key_id, uint8_t key_type) {
-    uint8_t private_key[32];
-    generateRandomNumber(private_key, 32);
-    return storeKey(key_id, private_key, key_type);
+static void aes128EncryptPortable(const Aes128Key *key, const uint8_t *in, uint8_t *out) {
+    uint32_t s[4], t[4];
+    for (int c = 0; c < 4; c++) {
+        s[c] = loadLe32(in + 4 * c) ^ key->rk[c];
+    }
+    for (int round = 1; round <= 10; round++) {
+        for (int c = 0; c < 4; c++) {
+            s[c] = aesSubWord(s[c]);
+        }
+        // ShiftRows: row r of column c comes from column c + r
+        for (int c = 0; c < 4; c++) {
+            t[c] = (s[c] & 0x000000FF) | (s[(c + 1) & 3] & 0x0000FF00) |
+                   (s[(c + 2) & 3] & 0x00FF0000) | (s[(c + 3) & 3] & 0xFF000000);
+        }
+        for (int c = 0; c < 4; c++) {
+            s[c] = (round < 10 ? aesMixColumn(t[c]) : t[c]) ^ key->rk[4 * round + c];
+        }
+    }
+    for (int c = 0; c < 4; c++) {
+        storeLe32(out + 4 * c, s[c]);
+    }
 }
 
-static bool computeHMAC(uint8_t key_id, const uint8_t *message, uint8_t *hmac) {
-    uint8_t key[32];
-    if (!read(ZONE_DATA, 32 * key_id, key, 32)) {
-        return false;
+static void aes128DecryptPortable(const Aes128Key *key, const uint8_t *in, uint8_t *out) {
+    uint32_t s[4], t[4];
+    for (int c = 0; c < 4; c++) {
+        s[c] = loadLe32(in + 4 * c) ^ key->rk[40 + c];
     }
-    for (uint8_t i = 0; i < 32; i++) {
-        hmac[i] = key[i] ^ message[i];
+    for (int round = 9; round >= 0; round--) {
+        // InvShiftRows: row r of column c comes from column c - r
+        for (int c = 0; c < 4; c++) {
+            t[c] = (s[c] & 0x000000FF) | (s[(c + 3) & 3] & 0x0000FF00) |
+                   (s[(c + 2) & 3] & 0x00FF0000) | (s[(c + 1) & 3] & 0xFF000000);
+        }
+        for (int c = 0; c < 4; c++) {
+            uint32_t w = aesInvSubWord(t[c]) ^ key->rk[4 * round + c];
+            s[c] = round > 0 ? aesInvMixColumn(w) : w;
+        }
+    }
+    for (int c = 0; c < 4; c++) {
+        storeLe32(out + 4 * c, s[c]);
     }
-    return true;
 }
 
-static bool deriveKey(uint8_t parent_key_id, uint8_t *derived_key) {
-    uint8_t parent_key[32];
-    if (!read(ZONE_DATA, 32 * parent_key_id, parent_key, 32)) {
-        return false;
+static void aesPrepareDecryptPortable(Aes128Key *key) {
+    // The portable inverse cipher runs straight off rk
+}
+
+// The hardware engines rely on the round key words being laid out in memory
+// as the standard byte-order schedule, which holds on little-endian hosts.
+#if defined(AES_X86_NI)
+__attribute__((target("aes,sse2")))
+static void aes128EncryptNi(const Aes128Key *key, const uint8_t *in, uint8_t *out) {
+    const __m128i *rk = (const __m128i *)key->rk;
+    __m128i s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in), _mm_loadu_si128(&rk[0]));
+    for (int i = 1; i < 10; i++) {
+        s = _mm_aesenc_si128(s, _mm_loadu_si128(&rk[i]));
     }
-    for (uint8_t i = 0; i < 32; i++) {
-        derived_key[i] = parent_key[i] ^ (i + 1);
+    _mm_storeu_si128((__m128i *)out, _mm_aesenclast_si128(s, _mm_loadu_si128(&rk[10])));
+}
+
+__attribute__((target("aes,sse2")))
+static void aes128DecryptNi(const Aes128Key *key, const uint8_t *in, uint8_t *out) {
+    __m128i s = _mm_xor_si128(_mm_loadu_si128((const __m128i *)in),
+                              _mm_loadu_si128((const __m128i *)key->dk[0]));
+    for (int i = 1; i < 10; i++) {
+        s = _mm_aesdec_si128(s, _mm_loadu_si128((const __m128i *)key->dk[i]));
     }
-    return true;
+    s = _mm_aesdeclast_si128(s, _mm_loadu_si128((const __m128i *)key->dk[10]));
+    _mm_storeu_si128((__m128i *)out, s);
 }
 
-static void simulateExecutionTime(uint32_t duration) {
-    device.executionTime = duration;
-    // In a real simulation, you might want to actually delay here
-    // For Wokwi, we'll just store the duration
+__attribute__((target("aes,sse2")))
+static void aesPrepareDecryptNi(Aes128Key *key) {
+    const __m128i *rk = (const __m128i *)key->rk;
+    _mm_storeu_si128((__m128i *)key->dk[0], _mm_loadu_si128(&rk[10]));
+    for (int i = 1; i < 10; i++) {
+        _mm_storeu_si128((__m128i *)key->dk[i], _mm_aesimc_si128(_mm_loadu_si128(&rk[10 - i])));
+    }
+    _mm_storeu_si128((__m128i *)key->dk[10], _mm_loadu_si128(&rk[0]));
 }
 
-static void setResponse(uint8_t *data, uint8_t len) {
-    memcpy(device.responsePacket, data, len);
-    device.responsePos = 0;
+static bool hostHasAesNi(void) {
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES);
 }
+#endif
 
-void atecc608_reset(void) {
-    atecc608_init();
+#if defined(AES_ARMV8)
+static void aes128EncryptArmv8(const Aes128Key *key, const uint8_t *in, uint8_t *out) {
+    const uint8_t *rk = (const uint8_t *)key->rk;
+    uint8x16_t s = vld1q_u8(in);
+    for (int i = 0; i < 9; i++) {
+        s = vaesmcq_u8(vaeseq_u8(s, vld1q_u8(rk + 16 * i)));
+    }
+    s = vaeseq_u8(s, vld1q_u8(rk + 16 * 9));
+    vst1q_u8(out, veorq_u8(s, vld1q_u8(rk + 16 * 10)));
 }
 
-// Wokwi API integration
-static i2c_dev_t atecc608_dev = {
-    .address = ATECC608_ADDR,
-    .write_func = atecc608_write_byte,
-    .read_func = atecc608_read_byte
+static void aes128DecryptArmv8(const Aes128Key *key, const uint8_t *in, uint8_t *out) {
+    uint8x16_t s = vld1q_u8(in);
+    for (int i = 0; i < 9; i++) {
+        s = vaesimcq_u8(vaesdq_u8(s, vld1q_u8(key->dk[i])));
+    }
+    s = vaesdq_u8(s, vld1q_u8(key->dk[9]));
+    vst1q_u8(out, veorq_u8(s, vld1q_u8(key->dk[10])));
+}
+
+static void aesPrepareDecryptArmv8(Aes128Key *key) {
+    const uint8_t *rk = (const uint8_t *)key->rk;
+    vst1q_u8(key->dk[0], vld1q_u8(rk + 16 * 10));
+    for (int i = 1; i < 10; i++) {
+        vst1q_u8(key->dk[i], vaesimcq_u8(vld1q_u8(rk + 16 * (10 - i))));
+    }
+    vst1q_u8(key->dk[10], vld1q_u8(rk));
+}
+#endif
+
+static void (*aes128Encrypt)(const Aes128Key *key, const uint8_t *in, uint8_t *out);
+static void (*aes128Decrypt)(const Aes128Key *key, const uint8_t *in, uint8_t *out);
+
+static void aesSelectEngine(void) {
+    aes128Encrypt = aes128EncryptPortable;
+    aes128Decrypt = aes128DecryptPortable;
+    aesPrepareDecrypt = aesPrepareDecryptPortable;
+#if defined(AES_X86_NI)
+    if (hostHasAesNi()) {
+        aes128Encrypt = aes128EncryptNi;
+        aes128Decrypt = aes128DecryptNi;
+        aesPrepareDecrypt = aesPrepareDecryptNi;
+    }
+#elif defined(AES_ARMV8)
+    aes128Encrypt = aes128EncryptArmv8;
+    aes128Decrypt = aes128DecryptArmv8;
+    aesPrepareDecrypt = aesPrepareDecryptArmv8;
+#endif
+}
+
+// GCM field multiplication of two 16-byte blocks, bit-reflected as in
+// SP 800-38D. Constant time in both operands.
+static void gfmMultiply(const uint8_t *x, const uint8_t *y, uint8_t *out) {
+    uint64_t vh = 0, vl = 0, zh = 0, zl = 0;
+    for (int i = 0; i < 8; i++) {
+        vh = (vh << 8) | y[i];
+        vl = (vl << 8) | y[8 + i];
+    }
+    for (int i = 0; i < 128; i++) {
+        uint64_t bit = 0 - (uint64_t)((x[i / 8] >> (7 - i % 8)) & 1);
+        zh ^= vh & bit;
+        zl ^= vl & bit;
+        uint64_t carry = 0 - (vl & 1);
+        vl = (vl >> 1) | (vh << 63);
+        vh = (vh >> 1) ^ (0xE100000000000000ull & carry);
+    }
+    for (int i = 0; i < 8; i++) {
+        out[i] = zh >> (56 - 8 * i);
+        out[8 + i] = zl >> (56 - 8 * i);
+    }
+}
+
+// P-256 (secp256r1) arithmetic. Numbers are eight 32-bit limbs, least
+// significant first. Field and scalar elements are kept in Montgomery form
+// while computing; only the byte interfaces deal in plain big-endian values.
+#define BN_WORDS 8
+
+static const uint32_t eccP[BN_WORDS] = {
+    0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0x00000000,
+    0x00000000, 0x00000000, 0x00000001, 0xFFFFFFFF
+};
+static const uint32_t eccN[BN_WORDS] = {
+    0xFC632551, 0xF3B9CAC2, 0xA7179E84, 0xBCE6FAAD,
+    0xFFFFFFFF, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF
+};
+static const uint32_t eccPMinus2[BN_WORDS] = {
+    0xFFFFFFFD, 0xFFFFFFFF, 0xFFFFFFFF, 0x00000000,
+    0x00000000, 0x00000000, 0x00000001, 0xFFFFFFFF
+};
+static const uint32_t eccNMinus2[BN_WORDS] = {
+    0xFC63254F, 0xF3B9CAC2, 0xA7179E84, 0xBCE6FAAD,
+    0xFFFFFFFF, 0xFFFFFFFF, 0x00000000, 0xFFFFFFFF
+};
+// R^2 mod p and R^2 mod n, R = 2^256
+static const uint32_t eccRRP[BN_WORDS] = {
+    0x00000003, 0x00000000, 0xFFFFFFFF, 0xFFFFFFFB,
+    0xFFFFFFFE, 0xFFFFFFFF, 0xFFFFFFFD, 0x00000004
+};
+static const uint32_t eccRRN[BN_WORDS] = {
+    0xBE79EEA2, 0x83244C95, 0x49BD6FA6, 0x4699799C,
+    0x2B6BEC59, 0x2845B239, 0xF3D95620, 0x66E12D94
+};
+// 1, b, Gx and Gy in Montgomery form
+static const uint32_t eccOneP[BN_WORDS] = {
+    0x00000001, 0x00000000, 0x00000000, 0xFFFFFFFF,
+    0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFE, 0x00000000
+};
+static const uint32_t eccOneN[BN_WORDS] = {
+    0x039CDAAF, 0x0C46353D, 0x58E8617B, 0x43190552,
+    0x00000000, 0x00000000, 0xFFFFFFFF, 0x00000000
+};
+static const uint32_t eccB[BN_WORDS] = {
+    0x29C4BDDF, 0xD89CDF62, 0x78843090, 0xACF005CD,
+    0xF7212ED6, 0xE5A220AB, 0x04874834, 0xDC30061D
+};
+static const uint32_t eccGx[BN_WORDS] = {
+    0x18A9143C, 0x79E730D4, 0x5FEDB601, 0x75BA95FC,
+    0x77622510, 0x79FB732B, 0xA53755C6, 0x18905F76
+};
+static const uint32_t eccGy[BN_WORDS] = {
+    0xCE95560A, 0xDDF25357, 0xBA19E45C, 0x8B4AB8E4,
+    0xDD21F325, 0xD2E88688, 0x25885D85, 0x8571FF18
 };
 
-void chip_init() {
-    atecc608_init();
-    i2c_register_device(&atecc608_dev);
+static const uint32_t bnOne[BN_WORDS] = { 1 };
+
+#define ECC_P_MINV 0x00000001  // -p^-1 mod 2^32
+#define ECC_N_MINV 0xEE00BC4F  // -n^-1 mod 2^32
+
+typedef struct {
+    uint32_t x[BN_WORDS];
+    uint32_t y[BN_WORDS];
+    uint32_t z[BN_WORDS];  // Jacobian, z == 0 is the point at infinity
+} EccPoint;
+
+typedef struct {
+    uint32_t x[BN_WORDS];
+    uint32_t y[BN_WORDS];
+} EccAffine;
+
+// Multiples 1..15 of a point, for 4-bit fixed-window multiplication
+typedef struct {
+    EccPoint p[16];
+} EccWindowTable;
+
+// All-ones if x == 0, else zero
+static inline uint32_t ctIsZero(uint32_t x) {
+    return (uint32_t)(((uint64_t)x - 1) >> 32);
+}
+
+static uint32_t bnAdd(uint32_t *r, const uint32_t *a, const uint32_t *b) {
+    uint64_t carry = 0;
+    for (int i = 0; i < BN_WORDS; i++) {
+        carry += (uint64_t)a[i] + b[i];
+        r[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    return (uint32_t)carry;
+}
+
+static uint32_t bnSub(uint32_t *r, const uint32_t *a, const uint32_t *b) {
+    uint32_t borrow = 0;
+    for (int i = 0; i < BN_WORDS; i++) {
+        uint64_t t = (uint64_t)a[i] - b[i] - borrow;
+        r[i] = (uint32_t)t;
+        borrow = (uint32_t)(t >> 63);
+    }
+    return borrow;
+}
+
+// r = mask ? a : b, mask is all-ones or zero
+static void bnSelect(uint32_t *r, const uint32_t *a, const uint32_t *b, uint32_t mask) {
+    for (int i = 0; i < BN_WORDS; i++) {
+        r[i] = (a[i] & mask) | (b[i] & ~mask);
+    }
+}
+
+static uint32_t bnIsZero(const uint32_t *a) {
+    uint32_t acc = 0;
+    for (int i = 0; i < BN_WORDS; i++) {
+        acc |= a[i];
+    }
+    return ctIsZero(acc);
+}
+
+static bool bnLess(const uint32_t *a, const uint32_t *b) {
+    uint32_t t[BN_WORDS];
+    return bnSub(t, a, b);
+}
+
+static void bnFromBytes(uint32_t *r, const uint8_t *in) {
+    for (int i = 0; i < BN_WORDS; i++) {
+        const uint8_t *b = in + 28 - 4 * i;
+        r[i] = (uint32_t)b[0] << 24 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 8 | b[3];
+    }
+}
+
+static void bnToBytes(uint8_t *out, const uint32_t *a) {
+    for (int i = 0; i < BN_WORDS; i++) {
+        uint8_t *b = out + 28 - 4 * i;
+        b[0] = a[i] >> 24;
+        b[1] = a[i] >> 16;
+        b[2] = a[i] >> 8;
+        b[3] = a[i];
+    }
+}
+
+static void modAdd(uint32_t *r, const uint32_t *a, const uint32_t *b, const uint32_t *m) {
+    uint32_t t[BN_WORDS];
+    uint32_t carry = bnAdd(r, a, b);
+    uint32_t borrow = bnSub(t, r, m);
+    bnSelect(r, t, r, 0 - (carry | (borrow ^ 1)));
+}
+
+static void modSub(uint32_t *r, const uint32_t *a, const uint32_t *b, const uint32_t *m) {
+    uint32_t t[BN_WORDS];
+    uint32_t borrow = bnSub(r, a, b);
+    bnAdd(t, r, m);
+    bnSelect(r, t, r, 0 - borrow);
+}
+
+// Montgomery multiplication r = a * b / R mod m (CIOS)
+static void montMul(uint32_t *r, const uint32_t *a, const uint32_t *b,
+                    const uint32_t *m, uint32_t minv) {
+    uint32_t t[BN_WORDS + 2] = {0};
+    for (int i = 0; i < BN_WORDS; i++) {
+        uint64_t c = 0;
+        for (int j = 0; j < BN_WORDS; j++) {
+            c += t[j] + (uint64_t)a[j] * b[i];
+            t[j] = (uint32_t)c;
+            c >>= 32;
+        }
+        c += t[BN_WORDS];
+        t[BN_WORDS] = (uint32_t)c;
+        t[BN_WORDS + 1] = (uint32_t)(c >> 32);
+
+        uint32_t u = t[0] * minv;
+        c = (t[0] + (uint64_t)u * m[0]) >> 32;
+        for (int j = 1; j < BN_WORDS; j++) {
+            c += t[j] + (uint64_t)u * m[j];
+            t[j - 1] = (uint32_t)c;
+            c >>= 32;
+        }
+        c += t[BN_WORDS];
+        t[BN_WORDS - 1] = (uint32_t)c;
+        t[BN_WORDS] = t[BN_WORDS + 1] + (uint32_t)(c >> 32);
+    }
+    uint32_t s[BN_WORDS];
+    uint32_t borrow = bnSub(s, t, m);
+    bnSelect(r, s, t, 0 - (t[BN_WORDS] | (borrow ^ 1)));
+}
+
+// r = a^e in Montgomery form, e is public
+static void montPow(uint32_t *r, const uint32_t *a, const uint32_t *e,
+                    const uint32_t *m, uint32_t minv, const uint32_t *one) {
+    uint32_t acc[BN_WORDS];
+    memcpy(acc, one, sizeof(acc));
+    for (int i = 255; i >= 0; i--) {
+        montMul(acc, acc, acc, m, minv);
+        if ((e[i / 32] >> (i % 32)) & 1) {
+            montMul(acc, acc, a, m, minv);
+        }
+    }
+    memcpy(r, acc, sizeof(acc));
+}
+
+static inline void fpMul(uint32_t *r, const uint32_t *a, const uint32_t *b) {
+    montMul(r, a, b, eccP, ECC_P_MINV);
+}
+
+static inline void fpSqr(uint32_t *r, const uint32_t *a) {
+    montMul(r, a, a, eccP, ECC_P_MINV);
+}
+
+static inline void fpAdd(uint32_t *r, const uint32_t *a, const uint32_t *b) {
+    modAdd(r, a, b, eccP);
+}
+
+static inline void fpSub(uint32_t *r, const uint32_t *a, const uint32_t *b) {
+    modSub(r, a, b, eccP);
+}
+
+static inline void fpFromMont(uint32_t *r, const uint32_t *a) {
+    montMul(r, a, bnOne, eccP, ECC_P_MINV);
+}
+
+static inline void fpInv(uint32_t *r, const uint32_t *a) {
+    montPow(r, a, eccPMinus2, eccP, ECC_P_MINV, eccOneP);
+}
+
+static inline void fnMul(uint32_t *r, const uint32_t *a, const uint32_t *b) {
+    montMul(r, a, b, eccN, ECC_N_MINV);
+}
+
+static inline void fnInv(uint32_t *r, const uint32_t *a) {
+    montPow(r, a, eccNMinus2, eccN, ECC_N_MINV, eccOneN);
+}
+
+// dbl-2001-b, a = -3
+static void pointDouble(EccPoint *r, const EccPoint *p) {
+    uint32_t delta[BN_WORDS], gamma[BN_WORDS], beta[BN_WORDS], alpha[BN_WORDS];
+    uint32_t t1[BN_WORDS], t2[BN_WORDS];
+
+    fpSqr(delta, p->z);
+    fpSqr(gamma, p->y);
+    fpMul(beta, p->x, gamma);
+    fpSub(t1, p->x, delta);
+    fpAdd(t2, p->x, delta);
+    fpMul(alpha, t1, t2);
+    fpAdd(t1, alpha, alpha);
+    fpAdd(alpha, t1, alpha);
+
+    fpAdd(t1, p->y, p->z);
+    fpSqr(t1, t1);
+    fpSub(t1, t1, gamma);
+    fpSub(r->z, t1, delta);
+
+    fpAdd(beta, beta, beta);
+    fpAdd(beta, beta, beta);  // 4 * beta
+    fpSqr(t1, alpha);
+    fpAdd(t2, beta, beta);
+    fpSub(r->x, t1, t2);
+
+    fpSub(t1, beta, r->x);
+    fpMul(t1, alpha, t1);
+    fpSqr(gamma, gamma);
+    fpAdd(gamma, gamma, gamma);
+    fpAdd(gamma, gamma, gamma);
+    fpAdd(gamma, gamma, gamma);  // 8 * gamma^2
+    fpSub(r->y, t1, gamma);
+}
+
+// madd-2007-bl. p must not be infinity or equal to +-q, callers handle that.
+static void pointAddMixed(EccPoint *r, const EccPoint *p, const EccAffine *q) {
+    uint32_t z1z1[BN_WORDS], u2[BN_WORDS], s2[BN_WORDS], h[BN_WORDS], hh[BN_WORDS];
+    uint32_t i[BN_WORDS], j[BN_WORDS], rr[BN_WORDS], v[BN_WORDS], t[BN_WORDS];
+
+    fpSqr(z1z1, p->z);
+    fpMul(u2, q->x, z1z1);
+    fpMul(s2, q->y, p->z);
+    fpMul(s2, s2, z1z1);
+    fpSub(h, u2, p->x);
+    fpSqr(hh, h);
+    fpAdd(i, hh, hh);
+    fpAdd(i, i, i);
+    fpMul(j, h, i);
+    fpSub(rr, s2, p->y);
+    fpAdd(rr, rr, rr);
+    fpMul(v, p->x, i);
+
+    fpAdd(t, p->z, h);
+    fpSqr(t, t);
+    fpSub(t, t, z1z1);
+    fpSub(r->z, t, hh);
+
+    uint32_t y1[BN_WORDS];
+    memcpy(y1, p->y, sizeof(y1));
+    fpSqr(t, rr);
+    fpSub(t, t, j);
+    fpSub(t, t, v);
+    fpSub(r->x, t, v);
+
+    fpSub(t, v, r->x);
+    fpMul(t, rr, t);
+    fpMul(y1, y1, j);
+    fpAdd(y1, y1, y1);
+    fpSub(r->y, t, y1);
+}
+
+static void pointSelect(EccPoint *r, const EccPoint *a, const EccPoint *b, uint32_t mask) {
+    bnSelect(r->x, a->x, b->x, mask);
+    bnSelect(r->y, a->y, b->y, mask);
+    bnSelect(r->z, a->z, b->z, mask);
+}
+
+// add-2007-bl. Infinity on either side is handled without branching; the
+// p == q case only happens for public inputs and falls back to doubling.
+static void pointAdd(EccPoint *r, const EccPoint *p, const EccPoint *q) {
+    uint32_t z1z1[BN_WORDS], z2z2[BN_WORDS], u1[BN_WORDS], u2[BN_WORDS];
+    uint32_t s1[BN_WORDS], s2[BN_WORDS], h[BN_WORDS], i[BN_WORDS];
+    uint32_t j[BN_WORDS], rr[BN_WORDS], v[BN_WORDS], t[BN_WORDS];
+    EccPoint sum;
+
+    fpSqr(z1z1, p->z);
+    fpSqr(z2z2, q->z);
+    fpMul(u1, p->x, z2z2);
+    fpMul(u2, q->x, z1z1);
+    fpMul(s1, p->y, q->z);
+    fpMul(s1, s1, z2z2);
+    fpMul(s2, q->y, p->z);
+    fpMul(s2, s2, z1z1);
+    fpSub(h, u2, u1);
+    fpSub(rr, s2, s1);
+
+    uint32_t pInf = bnIsZero(p->z);
+    uint32_t qInf = bnIsZero(q->z);
+    if (!pInf && !qInf && bnIsZero(h) && bnIsZero(rr)) {
+        pointDouble(r, p);
+        return;
+    }
+
+    fpAdd(i, h, h);
+    fpSqr(i, i);
+    fpMul(j, h, i);
+    fpAdd(rr, rr, rr);
+    fpMul(v, u1, i);
+
+    fpSqr(t, rr);
+    fpSub(t, t, j);
+    fpSub(t, t, v);
+    fpSub(sum.x, t, v);
+
+    fpSub(t, v, sum.x);
+    fpMul(t, rr, t);
+    fpMul(s1, s1, j);
+    fpAdd(s1, s1, s1);
+    fpSub(sum.y, t, s1);
+
+    fpAdd(t, p->z, q->z);
+    fpSqr(t, t);
+    fpSub(t, t, z1z1);
+    fpSub(t, t, z2z2);
+    fpMul(sum.z, t, h);
+
+    pointSelect(&sum, q, &sum, pInf);
+    pointSelect(r, p, &sum, qInf);
+}
+
+static void pointToAffine(EccAffine *r, const EccPoint *p) {
+    uint32_t zinv[BN_WORDS], zinv2[BN_WORDS];
+    fpInv(zinv, p->z);
+    fpSqr(zinv2, zinv);
+    fpMul(r->x, p->x, zinv2);
+    fpMul(zinv2, zinv2, zinv);
+    fpMul(r->y, p->y, zinv2);
+}
+
+// Base-point table: eccBaseTable[i][j - 1] = j * 16^i * G in affine
+// Montgomery form, built once on first use.
+static EccAffine eccBaseTable[64][15];
+static bool eccBaseTableReady;
+
+static void eccBuildBaseTable(void) {
+    EccPoint base;
+    memcpy(base.x, eccGx, sizeof(base.x));
+    memcpy(base.y, eccGy, sizeof(base.y));
+    memcpy(base.z, eccOneP, sizeof(base.z));
+
+    for (int i = 0; i < 64; i++) {
+        EccPoint row[15];
+        row[0] = base;
+        pointDouble(&row[1], &base);
+        for (int j = 2; j < 15; j++) {
+            pointAdd(&row[j], &row[j - 1], &base);
+        }
+
+        // Batch inversion of the Z coordinates
+        uint32_t prefix[15][BN_WORDS], inv[BN_WORDS], zinv[BN_WORDS], t[BN_WORDS];
+        memcpy(prefix[0], row[0].z, sizeof(prefix[0]));
+        for (int j = 1; j < 15; j++) {
+            fpMul(prefix[j], prefix[j - 1], row[j].z);
+        }
+        fpInv(inv, prefix[14]);
+        for (int j = 14; j >= 0; j--) {
+            if (j > 0) {
+                fpMul(zinv, inv, prefix[j - 1]);
+                fpMul(inv, inv, row[j].z);
+            } else {
+                memcpy(zinv, inv, sizeof(zinv));
+            }
+            fpSqr(t, zinv);
+            fpMul(eccBaseTable[i][j].x, row[j].x, t);
+            fpMul(t, t, zinv);
+            fpMul(eccBaseTable[i][j].y, row[j].y, t);
+        }
+
+        pointDouble(&base, &row[7]);  // 16 * 16^i * G
+    }
+    eccBaseTableReady = true;
+}
+
+// r = k * G, k is a plain scalar below n. Constant time in k.
+static void scalarMultBase(EccPoint *r, const uint32_t *k) {
+    if (!eccBaseTableReady) {
+        eccBuildBaseTable();
+    }
+
+    EccPoint acc;
+    memset(&acc, 0, sizeof(acc));
+    uint32_t accInf = 0xFFFFFFFF;
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t digit = (k[i / 8] >> ((i % 8) * 4)) & 0x0F;
+
+        EccAffine t;
+        memset(&t, 0, sizeof(t));
+        for (uint32_t j = 1; j < 16; j++) {
+            uint32_t mask = ctIsZero(digit ^ j);
+            bnSelect(t.x, eccBaseTable[i][j - 1].x, t.x, mask);
+            bnSelect(t.y, eccBaseTable[i][j - 1].y, t.y, mask);
+        }
+
+        EccPoint sum, fromTable;
+        pointAddMixed(&sum, &acc, &t);
+        memcpy(fromTable.x, t.x, sizeof(t.x));
+        memcpy(fromTable.y, t.y, sizeof(t.y));
+        memcpy(fromTable.z, eccOneP, sizeof(fromTable.z));
+        pointSelect(&sum, &fromTable, &sum, accInf);
+
+        uint32_t digitZero = ctIsZero(digit);
+        pointSelect(&acc, &acc, &sum, digitZero);
+        accInf &= digitZero;
+    }
+    *r = acc;
+}
+
+static void eccPrecompute(EccWindowTable *table, const EccAffine *q) {
+    memset(&table->p[0], 0, sizeof(table->p[0]));
+    memcpy(table->p[1].x, q->x, sizeof(q->x));
+    memcpy(table->p[1].y, q->y, sizeof(q->y));
+    memcpy(table->p[1].z, eccOneP, sizeof(eccOneP));
+    pointDouble(&table->p[2], &table->p[1]);
+    for (int j = 3; j < 16; j++) {
+        pointAdd(&table->p[j], &table->p[j - 1], &table->p[1]);
+    }
+}
+
+// r = k * Q using a table from eccPrecompute(). Constant time in k.
+static void scalarMult(EccPoint *r, const EccWindowTable *table, const uint32_t *k) {
+    EccPoint acc;
+    memset(&acc, 0, sizeof(acc));
+
+    for (int i = 63; i >= 0; i--) {
+        for (int d = 0; d < 4; d++) {
+            pointDouble(&acc, &acc);
+        }
+        uint32_t digit = (k[i / 8] >> ((i % 8) * 4)) & 0x0F;
+        EccPoint t = table->p[0];
+        for (uint32_t j = 1; j < 16; j++) {
+            pointSelect(&t, &table->p[j], &t, ctIsZero(digit ^ j));
+        }
+        pointAdd(&acc, &acc, &t);
+    }
+    *r = acc;
+}
+
+static bool eccIsValidScalar(const uint32_t *k) {
+    return !bnIsZero(k) && bnLess(k, eccN);
+}
+
+// Decodes X || Y and checks that the point is on the curve
+static bool eccLoadPublicKey(EccAffine *q, const uint8_t *public_key) {
+    uint32_t x[BN_WORDS], y[BN_WORDS], lhs[BN_WORDS], rhs[BN_WORDS], t[BN_WORDS];
+    bnFromBytes(x, public_key);
+    bnFromBytes(y, public_key + 32);
+    if (!bnLess(x, eccP) || !bnLess(y, eccP)) {
+        return false;
+    }
+    fpMul(q->x, x, eccRRP);
+    fpMul(q->y, y, eccRRP);
+
+    fpSqr(lhs, q->y);
+    fpSqr(rhs, q->x);
+    fpMul(rhs, rhs, q->x);
+    fpAdd(t, q->x, q->x);
+    fpAdd(t, t, q->x);
+    fpSub(rhs, rhs, t);
+    fpAdd(rhs, rhs, eccB);
+    return memcmp(lhs, rhs, sizeof(lhs)) == 0;
+}
+
+// Reduces a 256-bit big-endian value (a digest or a coordinate) mod n
+static void eccReduceN(uint32_t *r, const uint32_t *a) {
+    uint32_t t[BN_WORDS];
+    uint32_t borrow = bnSub(t, a, eccN);
+    bnSelect(r, a, t, 0 - borrow);
+}
+
+static bool eccIsValidPrivateKey(const uint8_t *private_key) {
+    uint32_t d[BN_WORDS];
+    bnFromBytes(d, private_key);
+    return eccIsValidScalar(d);
+}
+
+static bool eccComputePublicKey(const uint8_t *private_key, uint8_t *public_key) {
+    uint32_t d[BN_WORDS], t[BN_WORDS];
+    bnFromBytes(d, private_key);
+    if (!eccIsValidScalar(d)) {
+        return false;
+    }
+    EccPoint p;
+    EccAffine a;
+    scalarMultBase(&p, d);
+    pointToAffine(&a, &p);
+    fpFromMont(t, a.x);
+    bnToBytes(public_key, t);
+    fpFromMont(t, a.y);
+    bnToBytes(public_key + 32, t);
+    return true;
+}
+
+// ECDH premaster secret: the X coordinate of private_key * public_key. Uses
+// the same constant-time windowed multiplication as verification.
+static bool eccSharedSecret(const uint8_t *private_key, const uint8_t *public_key, uint8_t *secret) {
+    uint32_t d[BN_WORDS], t[BN_WORDS];
+    EccAffine q;
+    bnFromBytes(d, private_key);
+    if (!eccIsValidScalar(d) || !eccLoadPublicKey(&q, public_key)) {
+        return false;
+    }
+    EccWindowTable table;
+    EccPoint p;
+    eccPrecompute(&table, &q);
+    scalarMult(&p, &table, d);
+    if (bnIsZero(p.z)) {
+        return false;
+    }
+    EccAffine a;
+    pointToAffine(&a, &p);
+    fpFromMont(t, a.x);
+    bnToBytes(secret, t);
+    return true;
+}
+
+// ECDSA signature R || S with the caller's per-signature nonce. Fails if the
+// nonce is out of range or yields r or s == 0; the caller retries.
+static bool eccSign(const uint8_t *private_key, const uint8_t *digest,
+                    const uint8_t *nonce, uint8_t *signature) {
+    uint32_t d[BN_WORDS], k[BN_WORDS], e[BN_WORDS], r[BN_WORDS], s[BN_WORDS];
+    uint32_t t[BN_WORDS];
+    bnFromBytes(d, private_key);
+    bnFromBytes(k, nonce);
+    if (!eccIsValidScalar(d) || !eccIsValidScalar(k)) {
+        return false;
+    }
+
+    EccPoint p;
+    EccAffine a;
+    scalarMultBase(&p, k);
+    pointToAffine(&a, &p);
+    fpFromMont(t, a.x);
+    eccReduceN(r, t);
+    if (bnIsZero(r)) {
+        return false;
+    }
+
+    bnFromBytes(t, digest);
+    eccReduceN(e, t);
+
+    // s = k^-1 * (e + r * d), with one operand of each product in
+    // Montgomery form so the results come out plain
+    uint32_t km[BN_WORDS], kinv[BN_WORDS], dm[BN_WORDS];
+    fnMul(km, k, eccRRN);
+    fnInv(kinv, km);
+    fnMul(dm, d, eccRRN);
+    fnMul(t, r, dm);
+    modAdd(t, t, e, eccN);
+    fnMul(s, t, kinv);
+    if (bnIsZero(s)) {
+        return false;
+    }
+
+    bnToBytes(signature, r);
+    bnToBytes(signature + 32, s);
+    return true;
+}
+
+// ECDSA verification against a public key table from eccPrecompute()
+static bool eccVerify(const EccWindowTable *table, const uint8_t *digest,
+                      const uint8_t *signature) {
+    uint32_t r[BN_WORDS], s[BN_WORDS], e[BN_WORDS], t[BN_WORDS];
+    bnFromBytes(r, signature);
+    bnFromBytes(s, signature + 32);
+    if (!eccIsValidScalar(r) || !eccIsValidScalar(s)) {
+        return false;
+    }
+    bnFromBytes(t, digest);
+    eccReduceN(e, t);
+
+    uint32_t sm[BN_WORDS], w[BN_WORDS], u1[BN_WORDS], u2[BN_WORDS];
+    fnMul(sm, s, eccRRN);
+    fnInv(w, sm);
+    fnMul(u1, e, w);
+    fnMul(u2, r, w);
+
+    EccPoint p1, p2;
+    scalarMultBase(&p1, u1);
+    scalarMult(&p2, table, u2);
+    pointAdd(&p1, &p1, &p2);
+    if (bnIsZero(p1.z)) {
+        return false;
+    }
+
+    EccAffine a;
+    pointToAffine(&a, &p1);
+    fpFromMont(t, a.x);
+    eccReduceN(t, t);
+    return memcmp(t, r, sizeof(t)) == 0;
+}
+
+#define SLOT_COUNT 16
+
+// Chip variants. Each one gives its data zone layout slot by slot, its
+// factory config zone and the families of opcodes it implements, so data
+// zone addressing is a table lookup (see slotAddress()). The build picks one
+// with -DATECC608_VARIANT=..., the "variant" attribute overrides it.
+#define VARIANT_GENERIC 0    // Sixteen 64-byte slots and a blank config zone
+#define VARIANT_ATECC508A 1
+#define VARIANT_ATECC608A 2
+#define VARIANT_ATECC608B 3
+#define VARIANT_TRUSTFLEX 4  // ATECC608B-TFLXTLS, provisioned and locked
+#define VARIANT_COUNT 5
+
+#ifndef ATECC608_VARIANT
+#define ATECC608_VARIANT VARIANT_GENERIC
+#endif
+
+// Opcode families, see CommandDescriptor.families
+#define FAMILY_508 0x01
+#define FAMILY_608 0x02
+#define FAMILY_ALL (FAMILY_508 | FAMILY_608)
+
+// KeyConfig fields, see provisionVariant()
+#define KEY_CONFIG_PRIVATE 0x0001
+#define KEY_CONFIG_KEY_TYPE_MASK 0x001C
+#define KEY_CONFIG_KEY_TYPE_P256 0x0010
+
+typedef struct {
+    uint16_t offset;  // Byte offset in dataZone
+    uint16_t size;
+} SlotLayout;
+
+typedef struct {
+    const char *name;
+    uint8_t family;       // FAMILY_* bit
+    uint16_t dataSize;    // Bytes of dataZone in use
+    SlotLayout slots[SLOT_COUNT];
+    bool blankConfig;     // Config stays 0xFF apart from the serial number and counters
+    uint8_t revision[4];  // Config bytes 4-7
+    uint8_t i2cAddress;   // Config byte 16, 7-bit address << 1
+    uint16_t slotConfig[SLOT_COUNT];
+    uint16_t keyConfig[SLOT_COUNT];
+    bool provisioned;     // Keys generated and both zones locked at reset
+} ChipVariant;
+
+#define SLOT_64(n) { (n) * 64, 64 }
+#define SLOT_36(n) { (n) * 36, 36 }
+#define SLOT_72(n) { 704 + ((n) - 9) * 72, 72 }
+
+// Uniform 16 x 64 bytes, the layout this model started with
+#define LAYOUT_UNIFORM { \
+    SLOT_64(0), SLOT_64(1), SLOT_64(2), SLOT_64(3), SLOT_64(4), SLOT_64(5), SLOT_64(6), SLOT_64(7), \
+    SLOT_64(8), SLOT_64(9), SLOT_64(10), SLOT_64(11), SLOT_64(12), SLOT_64(13), SLOT_64(14), SLOT_64(15) }
+// Datasheet layout: slots 0-7 hold 36 bytes, slot 8 416, slots 9-15 72
+#define LAYOUT_DATASHEET { \
+    SLOT_36(0), SLOT_36(1), SLOT_36(2), SLOT_36(3), SLOT_36(4), SLOT_36(5), SLOT_36(6), SLOT_36(7), \
+    { 288, 416 }, SLOT_72(9), SLOT_72(10), SLOT_72(11), SLOT_72(12), SLOT_72(13), SLOT_72(14), SLOT_72(15) }
+#define DATASHEET_DATA_SIZE 1208
+
+// Unprovisioned parts: every slot a writable, readable data slot
+#define SLOT_CONFIG_OPEN { \
+    0x0F0F, 0x0F0F, 0x0F0F, 0x0F0F, 0x0F0F, 0x0F0F, 0x0F0F, 0x0F0F, \
+    0x0F0F, 0x0F0F, 0x0F0F, 0x0F0F, 0x0F0F, 0x0F0F, 0x0F0F, 0x0F0F }
+#define KEY_CONFIG_DATA { \
+    0x001C, 0x001C, 0x001C, 0x001C, 0x001C, 0x001C, 0x001C, 0x001C, \
+    0x001C, 0x001C, 0x001C, 0x001C, 0x001C, 0x001C, 0x001C, 0x001C }
+
+static const ChipVariant chipVariants[VARIANT_COUNT] = {
+    [VARIANT_GENERIC] = {
+        .name = "generic", .family = FAMILY_ALL, .dataSize = 1024, .slots = LAYOUT_UNIFORM,
+        .revision = { 0x00, 0x00, 0x60, 0x02 }, .blankConfig = true, .i2cAddress = ATECC608_ADDR << 1,
+    },
+    [VARIANT_ATECC508A] = {
+        .name = "ATECC508A", .family = FAMILY_508, .dataSize = DATASHEET_DATA_SIZE, .slots = LAYOUT_DATASHEET,
+        .revision = { 0x00, 0x00, 0x50, 0x00 }, .i2cAddress = 0xC0,
+        .slotConfig = SLOT_CONFIG_OPEN, .keyConfig = KEY_CONFIG_DATA,
+    },
+    [VARIANT_ATECC608A] = {
+        .name = "ATECC608A", .family = FAMILY_608, .dataSize = DATASHEET_DATA_SIZE, .slots = LAYOUT_DATASHEET,
+        .revision = { 0x00, 0x00, 0x60, 0x02 }, .i2cAddress = 0xC0,
+        .slotConfig = SLOT_CONFIG_OPEN, .keyConfig = KEY_CONFIG_DATA,
+    },
+    [VARIANT_ATECC608B] = {
+        .name = "ATECC608B", .family = FAMILY_608, .dataSize = DATASHEET_DATA_SIZE, .slots = LAYOUT_DATASHEET,
+        .revision = { 0x00, 0x00, 0x60, 0x03 }, .i2cAddress = 0xC0,
+        .slotConfig = SLOT_CONFIG_OPEN, .keyConfig = KEY_CONFIG_DATA,
+    },
+    // Modelled on the TrustFLEX slot map: P-256 private keys in 0-4 (0 fixed,
+    // 1-4 regenerable), IO protection key in 6, secrets in 5, 7 and 9,
+    // general data in 8, certificates in 10-12 and public keys in 13-15.
+    // The secret slots take clear writes, standing in for encrypted Write.
+    [VARIANT_TRUSTFLEX] = {
+        .name = "TrustFLEX", .family = FAMILY_608, .dataSize = DATASHEET_DATA_SIZE, .slots = LAYOUT_DATASHEET,
+        .revision = { 0x00, 0x00, 0x60, 0x03 }, .i2cAddress = 0x6C,
+        .slotConfig = {
+            0x8087, 0x2087, 0x2087, 0x2087, 0x2087, 0x008F, 0x008F, 0x008F,
+            0x0F0F, 0x008F, 0x0F0F, 0x0F0F, 0x0F0F, 0x0F0F, 0x0F0F, 0x0F0F },
+        .keyConfig = {
+            0x0033, 0x0033, 0x0033, 0x0033, 0x0033, 0x001C, 0x001C, 0x001C,
+            0x001C, 0x0018, 0x001C, 0x001C, 0x001C, 0x0010, 0x0010, 0x0010 },
+        .provisioned = true,
+    },
+};
+
+// Zone pages. The config zone, the OTP zone and every data slot is one page
+// covering a fixed range of the EEPROM image layout. Until a device first
+// writes a page it points into the variant's golden image, which all devices
+// share read-only; pageWritable() then gives the device its own copy. Reads
+// go straight through configZone, otpZone and slotData.
+#define PAGE_CONFIG 0
+#define PAGE_OTP 1
+#define PAGE_SLOT 2  // Data slot n is page PAGE_SLOT + n
+#define PAGE_COUNT (PAGE_SLOT + SLOT_COUNT)
+
+// Where a variant's golden image came from, see goldenImage()
+#define GOLDEN_NONE 0
+#define GOLDEN_FACTORY 1
+#define GOLDEN_FILE 2
+
+static uint8_t goldenImages[VARIANT_COUNT][EEPROM_SIZE];
+static uint8_t goldenSource[VARIANT_COUNT];  // GOLDEN_*
+
+// Read/Write mode and address fields
+#define ZONE_MASK 0x03
+#define ZONE_MODE_32_BYTES 0x80
+#define ZONE_MODE_ENCRYPTED 0x40
+
+// Lock modes
+#define LOCK_MODE_CONFIG 0x00
+#define LOCK_MODE_DATA 0x01
+#define LOCK_MODE_ZONE_MASK 0x03
+#define LOCK_MODE_NO_CRC 0x80
+
+// SlotConfig fields, see slotConfig()
+#define SLOT_CONFIG_ECDH_ALLOWED 0x0002
+#define SLOT_CONFIG_ECDH_TO_SLOT 0x0008  // Compatibility mode writes to slot N | 1
+#define SLOT_CONFIG_IS_SECRET 0x0080
+#define SLOT_CONFIG_WRITE_CONFIG_SHIFT 12
+#define WRITE_CONFIG_ALWAYS 0x0
+
+// Results derived from a slot's contents, dropped whenever the slot is written
+typedef struct {
+    bool publicKeyValid;
+    uint8_t publicKey[64];         // Public key of the private key in the slot
+    bool verifyTableValid;
+    EccWindowTable *verifyTable;  // For a public key stored in the slot
+    uint8_t aesKeyValid;          // One bit per 16-byte key block
+    Aes128Key *aesKeys;           // AES_KEY_BLOCKS expanded schedules
+    bool bootImageValid;
+    uint8_t *bootImage;  // Digest || signature SecureBoot last verified with the slot's key
+} SlotCache;
+
+// TempKey and its flags. Every command that consumes or produces an
+// internal digest (Nonce, SHA, Sign, Verify, and later MAC, GenDig, ECDH)
+// goes through this one record.
+typedef struct {
+    uint8_t value[64];
+    uint8_t keyId;    // Slot that contributed to the value, for GenDig/GenKey
+    bool sourceFlag;  // false: from the internal RNG, true: from host input
+    bool genDigData;
+    bool genKeyData;
+    bool noMacFlag;
+    bool valid;
+} TempKey;
+
+typedef enum {
+    IDLE,    // Asleep, TempKey and the other SRAM buffers are kept
+    SLEEP,   // Asleep, SRAM is cleared
+    ACTIVE
+} DeviceState;
+
+// Where the next byte of an I2C write transaction goes, see atecc608_write()
+typedef enum {
+    BUS_WORD_ADDRESS,
+    BUS_COUNT,
+    BUS_BODY,     // Count byte through the last data byte, covered by the CRC
+    BUS_CRC,
+    BUS_DISCARD   // Ignore everything up to the next start condition
+} BusState;
+
+// Info and SelfTest answer with packets framed ahead of time: Info's per
+// device whenever what they report changes, SelfTest's once per process
+// since every device runs the same engines
+#define INFO_RESPONSE_SIZE 7  // Count, 4 payload bytes, CRC
+#define SELFTEST_RESPONSE_SIZE 4
+
+static uint8_t selfTestResponses[SELFTEST_MODE_ALL + 1][SELFTEST_RESPONSE_SIZE];
+static bool selfTestReady;
+
+// Everything up to commandPacket is plain data and is what a snapshot holds,
+// see atecc608_snapshot(). Keep pointers and host resources below that line.
+typedef struct {
+    DeviceState state;
+    uint8_t lastError;
+    uint8_t variant;  // VARIANT_*, index into chipVariants
+    TempKey tempKey;
+    uint8_t msgDigBuf[64];  // Message digest buffer, Nonce target 0x40
+    uint8_t altKeyBuf[32];  // Alternate key buffer, Nonce target 0x80
+    HmacSha256Context sha;  // SHA command context, plain SHA uses sha.inner only
+    uint8_t shaContext;
+    bool gpioLatch;  // Output latch set through Info GPIO
+    uint64_t rng[4];  // xoshiro256** state
+    uint8_t commandPacket[MAX_PACKET_SIZE];
+    uint8_t responsePacket[256];  // Count, payload and CRC, ready to clock out
+    BusState busState;
+    uint8_t packetPos;    // Offset of the next packet byte
+    uint8_t responsePos;  // Wraps within responsePacket, no bounds check needed
+    uint16_t packetCRC;  // Running CRC over the command bytes received so far
+    uint8_t packetCRCLow;  // First CRC byte of the packet on the bus
+    uint32_t executionTime;
+    SlotCache slotCache[SLOT_COUNT];
+    bool shaStreaming;         // SHA Update payload goes to shaPending, not commandPacket
+    Sha256Context shaPending;  // Becomes sha.inner once the packet CRC checks out
+    uint32_t latency[LATENCY_ENTRIES];  // Resolved from latencyTable, in ms
+    bool busy;       // Executing a command, the I2C address is NACKed
+    uint32_t timer;  // One-shot that ends the current execution
+    bool waking;     // Wake pulse seen, wakeTimer running
+    bool watchdogArmed;
+    bool sdaLow;
+    uint64_t sdaLowSince;  // Simulated ns
+    uint32_t wakeTimer;
+    uint32_t watchdogTimer;
+    uint32_t wakeDelay;        // "wakeDelay" attribute, us
+    uint32_t watchdogTimeout;  // "watchdogTimeout" attribute, ms, 0 disables
+    uint32_t seed;        // "seed" attribute, 0 picks a fresh seed on every reset
+    DeviceStats stats;
+    uint32_t statsDumpAttr;  // "dumpStats" control, see checkStatsDump()
+    uint32_t statsDumpValue;
+    uint8_t address;  // 7-bit I2C address
+    FILE *trace;           // Optional command trace, see traceOpen()
+    uint8_t *traceBuffer;  // TRACE_BUFFER_SIZE bytes, flushed when full
+    size_t traceLen;
+    uint8_t tracePacket[256];  // Raw bytes of the packet being received
+    FILE *eeprom;         // Optional backing image, see eepromOpen()
+    uint64_t eepromDirty;  // One bit per EEPROM block not yet written back
+    const uint8_t *configZone;  // Zone pages, see pageWritable()
+    const uint8_t *otpZone;
+    const uint8_t *slotData[SLOT_COUNT];
+    uint32_t ownPages;  // One bit per page holding a private copy
+    uint8_t infoRevision[INFO_RESPONSE_SIZE];  // Framed Info answers, see refreshInfo()
+    uint8_t infoState[INFO_RESPONSE_SIZE];
+    uint8_t infoGpio[INFO_RESPONSE_SIZE];
+    uint8_t infoKeyValid[SLOT_COUNT][INFO_RESPONSE_SIZE];
+    uint16_t infoStaleKeys;  // One bit per slot whose KeyValid answer is out of date
+} ATECC608;
+
+// Snapshot: header, the leading plain-data part of ATECC608, then the zones
+// as an EEPROM image (EEPROM_SIZE bytes). Snapshots are only portable between
+// builds with the same struct layout; bump SNAPSHOT_VERSION whenever that
+// part of the struct changes.
+#define SNAPSHOT_MAGIC 0x38303641  // "A608"
+#define SNAPSHOT_VERSION 6
+#define SNAPSHOT_STATE_SIZE offsetof(ATECC608, commandPacket)
+#define SNAPSHOT_SIZE (sizeof(SnapshotHeader) + SNAPSHOT_STATE_SIZE + EEPROM_SIZE)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;  // SNAPSHOT_STATE_SIZE of the build that wrote it
+} SnapshotHeader;
+
+// Command trace, see traceOpen(). The file starts with
+//   u32 TRACE_MAGIC, u16 TRACE_VERSION, u32 snapshot length, snapshot
+// and holds one record per completed packet or power event, starting with
+// the u64 simulated ns. A packet record goes on with the count byte + rest
+// of the packet and the response count byte + rest of the response (a lone
+// 0 when there is none). A power event has a 0 count byte instead, followed
+// by its TRACE_EVENT_* byte. All integers are little-endian.
+#define TRACE_MAGIC 0x52543641  // "A6TR"
+#define TRACE_VERSION 2
+#define TRACE_BUFFER_SIZE 65536
+#define TRACE_EVENT_RESET CMD_RESET  // Word addresses keep their value
+#define TRACE_EVENT_SLEEP CMD_SLEEP
+#define TRACE_EVENT_IDLE CMD_IDLE
+#define TRACE_EVENT_WATCHDOG 0x10  // Watchdog sent the chip to sleep
+#define TRACE_EVENT_WAKE 0x11      // Wake finished, the chip answers again
+
+// One pre-built command for atecc608_batch()
+typedef struct {
+    uint8_t opcode;
+    uint8_t param1;
+    uint16_t param2;
+    const uint8_t *data;
+    uint8_t dataLen;
+} BatchCommand;
+
+// Function prototypes
+static void seedRandom(uint64_t *rng, uint64_t seed);
+static void generateRandomNumber(ATECC608 *dev, uint8_t *random, uint8_t length);
+static uint16_t calculateCRC(const uint8_t *data, size_t length);
+static void processCommand(ATECC608 *dev);
+static bool sendCommand(ATECC608 *dev, uint8_t command, uint8_t p1, uint16_t p2, const uint8_t *data, uint8_t dataLen);
+static const uint8_t *messageDigest(ATECC608 *dev, uint8_t mode);
+static bool signDigest(ATECC608 *dev, uint8_t key_id, const uint8_t *digest, uint8_t *signature);
+static bool verifySignature(const uint8_t *digest, const uint8_t *signature, const uint8_t *public_key);
+static bool verifyStoredSignature(ATECC608 *dev, uint8_t key_id, const uint8_t *digest, const uint8_t *signature);
+static bool verifyBootImage(ATECC608 *dev, uint8_t key_id, const uint8_t *image);
+static bool read(ATECC608 *dev, uint8_t zone, uint16_t address, uint8_t *data, uint8_t len);
+static bool write(ATECC608 *dev, uint8_t zone, uint16_t address, const uint8_t *data, uint8_t len);
+static bool zoneAddress(ATECC608 *dev, uint8_t zone, uint16_t param2, uint8_t size, uint16_t *address);
+static uint16_t slotConfig(ATECC608 *dev, uint8_t slot);
+static uint16_t keyConfig(ATECC608 *dev, uint8_t slot);
+static void markDirty(ATECC608 *dev, uint8_t zone, uint16_t address, uint16_t len);
+static uint8_t eepromBlocks(uint8_t variant);
+static void eepromOpen(ATECC608 *dev, uint8_t address);
+static void eepromLoad(ATECC608 *dev);
+static void eepromFlush(ATECC608 *dev);
+static bool lockConfigZone(ATECC608 *dev);
+static bool lockDataAndOTPZones(ATECC608 *dev);
+static bool isConfigLocked(ATECC608 *dev);
+static bool isDataAndOTPLocked(ATECC608 *dev);
+static bool slotWritable(ATECC608 *dev, uint8_t slot);
+static bool storeKey(ATECC608 *dev, uint8_t key_id, const uint8_t *key, uint8_t key_type);
+static bool generatePrivateKey(ATECC608 *dev, uint8_t key_id, uint8_t key_type);
+static bool computePublicKey(ATECC608 *dev, uint8_t key_id, uint8_t *public_key);
+static bool readPublicKey(ATECC608 *dev, uint8_t key_id, uint8_t *public_key);
+static void invalidateSlotCache(ATECC608 *dev, uint16_t address, uint16_t len);
+static bool encryptOutput(ATECC608 *dev, uint8_t *out, uint8_t len);
+static void simulateExecutionTime(ATECC608 *dev, uint32_t duration);
+static void setLatencyProfile(ATECC608 *dev, uint32_t profile);
+static uint32_t commandLatency(ATECC608 *dev, uint8_t opcode);
+static uint8_t lockState(ATECC608 *dev);
+static void setResponse(ATECC608 *dev, uint8_t *data, uint8_t len);
+static void setStatus(ATECC608 *dev, uint8_t status);
+static void cmdRandom(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len);
+static void cmdNonce(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len);
+static void cmdGenKey(ATECC608 *dev, uint8_t mode, uint16_t key_id, const uint8_t *data, uint8_t len);
+static void cmdSign(ATECC608 *dev, uint8_t mode, uint16_t key_id, const uint8_t *data, uint8_t len);
+static void cmdVerify(ATECC608 *dev, uint8_t mode, uint16_t key_id, const uint8_t *data, uint8_t len);
+static void cmdSha(ATECC608 *dev, uint8_t mode, uint16_t key_id, const uint8_t *data, uint8_t len);
+static void cmdEcdh(ATECC608 *dev, uint8_t mode, uint16_t key_id, const uint8_t *data, uint8_t len);
+static void cmdKdf(ATECC608 *dev, uint8_t mode, uint16_t key_id, const uint8_t *data, uint8_t len);
+static void cmdAes(ATECC608 *dev, uint8_t mode, uint16_t key_id, const uint8_t *data, uint8_t len);
+static const Aes128Key *slotAesKey(ATECC608 *dev, uint8_t slot, uint8_t block);
+static void cmdCounter(ATECC608 *dev, uint8_t mode, uint16_t counter_id, const uint8_t *data, uint8_t len);
+static void cmdSecureBoot(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len);
+static void cmdInfo(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len);
+static void cmdSelfTest(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len);
+static void refreshInfo(ATECC608 *dev);
+static void resetInfo(ATECC608 *dev);
+static void runSelfTests(void);
+static void frameResponse(uint8_t *packet, const uint8_t *payload, uint8_t len);
+static void sendFramed(ATECC608 *dev, const uint8_t *packet);
+static void cmdRead(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len);
+static void cmdWrite(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len);
+static void cmdLock(ATECC608 *dev, uint8_t mode, uint16_t summary, const uint8_t *data, uint8_t len);
+static void beginShaStream(ATECC608 *dev);
+static void finishShaStream(ATECC608 *dev, uint8_t len);
+static void finishResponse(ATECC608 *dev, uint8_t len);
+static void finishPacket(ATECC608 *dev, uint16_t crc);
+static void powerDown(ATECC608 *dev, DeviceState state);
+static void stopPowerTimers(ATECC608 *dev);
+static void on_wake_done(void *user_data);
+static uint64_t hostNanos(void);
+static void traceOpen(ATECC608 *dev);
+static void traceRecord(ATECC608 *dev, uint8_t count);
+static void traceEvent(ATECC608 *dev, uint8_t event);
+static void recordCommand(ATECC608 *dev, uint8_t slot, uint64_t start);
+static void loadDefaultConfig(uint8_t *config, const ChipVariant *variant);
+static const uint8_t *goldenImage(uint8_t variant);
+static const uint8_t **pageEntry(ATECC608 *dev, uint8_t page);
+static uint16_t pageOffset(ATECC608 *dev, uint8_t page);
+static uint16_t pageSize(ATECC608 *dev, uint8_t page);
+static uint8_t *pageWritable(ATECC608 *dev, uint8_t page);
+static void sharePages(ATECC608 *dev);
+static bool loadImage(ATECC608 *dev, const uint8_t *image);
+static void imageRead(ATECC608 *dev, uint16_t offset, uint8_t *out, uint16_t len);
+static bool zonePage(ATECC608 *dev, uint8_t zone, uint16_t address, uint8_t len, uint8_t *page, uint16_t *offset);
+static void provisionVariant(ATECC608 *dev);
+static uint16_t slotAddress(ATECC608 *dev, uint8_t slot);
+static uint16_t slotSize(ATECC608 *dev, uint8_t slot);
+
+void atecc608_init(ATECC608 *dev) {
+    stopPowerTimers(dev);
+    dev->state = SLEEP;  // Powers up asleep, see atecc608_wake()
+    dev->lastError = 0;
+    dev->busState = BUS_WORD_ADDRESS;
+    dev->packetPos = 0;
+    dev->responsePos = 0;
+    dev->executionTime = 0;
+    memset(&dev->tempKey, 0, sizeof(dev->tempKey));
+    memset(&dev->sha, 0, sizeof(dev->sha));
+    dev->shaContext = SHA_CONTEXT_NONE;
+    if (dev->busy) {
+        timer_stop(dev->timer);
+        dev->busy = false;
+    }
+    if (dev->variant >= VARIANT_COUNT) {
+        dev->variant = ATECC608_VARIANT;
+    }
+    sharePages(dev);
+    invalidateSlotCache(dev, 0, DATA_SIZE);
+
+    // Seed the random number generator
+    seedRandom(dev->rng, dev->seed ? dev->seed : (uint64_t)time(NULL) ^ (uintptr_t)dev);
+
+    // A golden image from a file is already provisioned
+    if (chipVariants[dev->variant].provisioned && goldenSource[dev->variant] == GOLDEN_FACTORY) {
+        provisionVariant(dev);
+    }
+    if (dev->eeprom) {
+        eepromLoad(dev);
+    }
+    if (!selfTestReady) {
+        runSelfTests();
+    }
+    dev->gpioLatch = false;
+    resetInfo(dev);
+}
+
+// Factory config zone of a variant. Serial number bytes 0-1 are 01 23 on
+// every part and the counters start at zero.
+static void loadDefaultConfig(uint8_t *config, const ChipVariant *variant) {
+    memset(config, 0xFF, CONFIG_SIZE);
+    config[0] = 0x01;
+    config[1] = 0x23;
+    memset(config + COUNTER_OFFSET, 0, COUNTER_COUNT * 8);
+    if (variant->blankConfig) {
+        return;
+    }
+    memcpy(config + 4, variant->revision, 4);
+    config[12] = 0xEE;  // Serial number byte 8
+    config[13] = variant->family == FAMILY_608;  // AES_Enable
+    config[14] = 0x01;  // I2C_Enable
+    config[15] = 0x00;
+    config[16] = variant->i2cAddress;
+    memset(config + 17, 0, 3);  // Reserved, CountMatch, ChipMode
+    for (uint8_t slot = 0; slot < SLOT_COUNT; slot++) {
+        config[20 + 2 * slot] = variant->slotConfig[slot];
+        config[21 + 2 * slot] = variant->slotConfig[slot] >> 8;
+        config[96 + 2 * slot] = variant->keyConfig[slot];
+        config[97 + 2 * slot] = variant->keyConfig[slot] >> 8;
+    }
+    memset(config + 68, 0, 18);  // UseLock through UserExtraAdd
+    config[86] = 0x55;  // LockValue, unlocked
+    config[87] = 0x55;  // LockConfig, unlocked
+    config[88] = 0xFF;  // SlotLocked
+    config[89] = 0xFF;
+    memset(config + 90, 0, 6);  // ChipOptions, X509format
+}
+
+// Pre-provisioned parts leave the factory with a P-256 key in every private
+// slot and both zones locked
+static void provisionVariant(ATECC608 *dev) {
+    const ChipVariant *variant = &chipVariants[dev->variant];
+    for (uint8_t slot = 0; slot < SLOT_COUNT; slot++) {
+        uint16_t key_config = variant->keyConfig[slot];
+        if ((key_config & KEY_CONFIG_PRIVATE) &&
+            (key_config & KEY_CONFIG_KEY_TYPE_MASK) == KEY_CONFIG_KEY_TYPE_P256) {
+            generatePrivateKey(dev, slot, 0);
+        }
+    }
+    lockConfigZone(dev);
+    lockDataAndOTPZones(dev);
+}
+
+// Per-device xoshiro256**, expanded from a 64-bit seed with splitmix64. A
+// fixed seed makes Random, GenKey and Sign output reproducible across runs.
+static void seedRandom(uint64_t *rng, uint64_t seed) {
+    for (int i = 0; i < 4; i++) {
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        rng[i] = z ^ (z >> 31);
+    }
+}
+
+#define ROTL64(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+static uint64_t nextRandom(uint64_t *s) {
+    uint64_t result = ROTL64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = ROTL64(s[3], 45);
+    return result;
+}
+
+static void generateRandomNumber(ATECC608 *dev, uint8_t *random, uint8_t length) {
+    while (length) {
+        uint64_t word = nextRandom(dev->rng);
+        uint8_t take = length < 8 ? length : 8;
+        for (uint8_t i = 0; i < take; i++) {
+            random[i] = word >> (8 * i);
+        }
+        random += take;
+        length -= take;
+    }
+}
+
+static uint16_t calculateCRC(const uint8_t *data, size_t length) {
+    uint16_t state = CRC_INIT;
+    for (size_t i = 0; i < length; i++) {
+        state = crc_update(state, data[i]);
+    }
+    return crc_final(state);
+}
+
+// Every opcode resolves to one descriptor, so dispatch, length checks and
+// the lock-state check are a single indexed lookup. Opcodes without a
+// handler, or outside the variant's families, are answered with a parse
+// error.
+typedef void (*CommandHandler)(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len);
+
+typedef struct {
+    CommandHandler handler;
+    uint8_t minLen;         // Data bytes between param2 and the CRC
+    uint8_t maxLen;
+    uint8_t latency;        // LAT_* slot
+    uint8_t allowedStates;  // LOCK_STATE_* mask
+    uint8_t families;       // FAMILY_* mask of the variants that implement it
+} CommandDescriptor;
+
+static const CommandDescriptor commandTable[256] = {
+    [CMD_RANDOM] = { cmdRandom, 0, 0, LAT_RANDOM, LOCK_STATE_ANY, FAMILY_ALL },
+    [CMD_NONCE] = { cmdNonce, 20, 64, LAT_NONCE, LOCK_STATE_ANY, FAMILY_ALL },
+    [CMD_GENKEY] = { cmdGenKey, 0, 3, LAT_GENKEY, LOCK_STATE_ANY, FAMILY_ALL },
+    [CMD_SIGN] = { cmdSign, 0, 0, LAT_SIGN, LOCK_STATE_ANY, FAMILY_ALL },
+    [CMD_VERIFY] = { cmdVerify, 64, 128, LAT_VERIFY, LOCK_STATE_ANY, FAMILY_ALL },
+    [CMD_SHA] = { cmdSha, 0, 128, LAT_SHA, LOCK_STATE_ANY, FAMILY_ALL },
+    [CMD_ECDH] = { cmdEcdh, 64, 64, LAT_ECDH, LOCK_STATE_ANY, FAMILY_ALL },
+    [CMD_KDF] = { cmdKdf, 4, 132, LAT_KDF, LOCK_STATE_ANY, FAMILY_608 },
+    [CMD_AES] = { cmdAes, 16, 32, LAT_AES, LOCK_STATE_ANY, FAMILY_608 },
+    [CMD_COUNTER] = { cmdCounter, 0, 0, LAT_COUNTER, LOCK_STATE_ANY, FAMILY_ALL },
+    [CMD_INFO] = { cmdInfo, 0, 0, LAT_INFO, LOCK_STATE_ANY, FAMILY_ALL },
+    [CMD_SELFTEST] = { cmdSelfTest, 0, 0, LAT_SELFTEST, LOCK_STATE_ANY, FAMILY_608 },
+    [CMD_SECUREBOOT] = { cmdSecureBoot, 32, 96, LAT_SECUREBOOT, LOCK_STATE_CONFIG_LOCKED | LOCK_STATE_LOCKED, FAMILY_608 },
+    [CMD_READ] = { cmdRead, 0, 0, LAT_READ, LOCK_STATE_ANY, FAMILY_ALL },
+    [CMD_WRITE] = { cmdWrite, 4, 32, LAT_WRITE, LOCK_STATE_ANY, FAMILY_ALL },
+    [CMD_LOCK] = { cmdLock, 0, 0, LAT_LOCK, LOCK_STATE_ANY, FAMILY_ALL },
+};
+
+static void processCommand(ATECC608 *dev) {
+    uint8_t command = dev->commandPacket[2];
+    uint8_t p1 = dev->commandPacket[3];
+    uint16_t p2 = (dev->commandPacket[5] << 8) | dev->commandPacket[4];
+    const uint8_t *data = &dev->commandPacket[6];
+    uint8_t count = dev->commandPacket[1];
+    if (count < 7 || count >= MAX_PACKET_SIZE) {  // Guards callers that fill commandPacket directly
+        dev->stats.rejected++;
+        setStatus(dev, STATUS_PARSE_ERROR);
+        return;
+    }
+    uint8_t dataLen = count - 7;
+
+    const CommandDescriptor *desc = &commandTable[command];
+    if (!desc->handler || !(desc->families & chipVariants[dev->variant].family)) {
+        dev->lastError = 7;
+        dev->stats.rejected++;
+        setStatus(dev, STATUS_PARSE_ERROR);
+        return;
+    }
+    if (dataLen < desc->minLen || dataLen > desc->maxLen) {
+        dev->stats.rejected++;
+        setStatus(dev, STATUS_PARSE_ERROR);
+        return;
+    }
+    if (!(desc->allowedStates & lockState(dev))) {
+        dev->stats.rejected++;
+        setStatus(dev, STATUS_EXECUTION_ERROR);
+        return;
+    }
+    uint64_t start = hostNanos();
+    desc->handler(dev, p1, p2, data, dataLen);
+    refreshInfo(dev);
+    if (dev->eepromDirty) {
+        eepromFlush(dev);
+    }
+    simulateExecutionTime(dev, dev->latency[desc->latency]);
+    recordCommand(dev, desc->latency, start);
+}
+
+uint8_t atecc608_read_byte(ATECC608 *dev) {
+    dev->stats.bytesOut++;
+    return dev->responsePacket[dev->responsePos++];
+}
+
+// Consumes a run of bytes from an I2C write transaction. Each bus phase
+// takes as much of the run as belongs to it in one step, so a caller that
+// has the whole packet (atecc608_execute(), the host tools) pays for one
+// CRC pass and one copy; the Wokwi callback passes runs of one byte.
+void atecc608_write(ATECC608 *dev, const uint8_t *data, size_t len) {
+    dev->stats.bytesIn += len;
+    while (len) {
+        size_t take = 1;
+        switch (dev->busState) {
+            case BUS_WORD_ADDRESS:
+                dev->busState = BUS_DISCARD;
+                switch (data[0]) {
+                    case CMD_COMMAND:
+                        dev->commandPacket[0] = CMD_COMMAND;
+                        dev->packetPos = 1;
+                        dev->packetCRC = CRC_INIT;
+                        dev->shaStreaming = false;
+                        dev->busState = BUS_COUNT;
+                        break;
+                    case CMD_RESET:  // Next read starts over at the count byte
+                        dev->responsePos = 0;
+                        traceEvent(dev, TRACE_EVENT_RESET);
+                        break;
+                    case CMD_SLEEP:
+                        powerDown(dev, SLEEP);
+                        traceEvent(dev, TRACE_EVENT_SLEEP);
+                        break;
+                    case CMD_IDLE:
+                        powerDown(dev, IDLE);
+                        traceEvent(dev, TRACE_EVENT_IDLE);
+                        break;
+                }
+                break;
+
+            case BUS_COUNT:
+                if (data[0] < 7) {  // Count too small to hold a command
+                    dev->stats.crcErrors++;
+                    setStatus(dev, STATUS_CRC_ERROR);
+                    dev->busState = BUS_DISCARD;
+                    break;
+                }
+                dev->commandPacket[1] = data[0];
+                if (dev->trace) {
+                    dev->tracePacket[1] = data[0];
+                }
+                dev->packetCRC = crc_update(dev->packetCRC, data[0]);
+                dev->packetPos = 2;
+                dev->busState = BUS_BODY;
+                break;
+
+            case BUS_BODY: {
+                // The count byte covers itself through the CRC, CRC bytes
+                // come last. Split the run after the parameters so an SHA
+                // Update can start streaming its data.
+                uint8_t pos = dev->packetPos;
+                uint8_t end = dev->commandPacket[1] - 1;
+                take = end - pos;
+                if (pos < 6 && take > 6u - pos) {
+                    take = 6 - pos;
+                }
+                if (take > len) {
+                    take = len;
+                }
+                uint16_t crc = dev->packetCRC;
+                for (size_t i = 0; i < take; i++) {
+                    crc = crc_update(crc, data[i]);
+                }
+                dev->packetCRC = crc;
+                if (dev->trace) {
+                    memcpy(dev->tracePacket + pos, data, take);
+                }
+                if (dev->shaStreaming) {
+                    if (take == 1) {  // The usual case from the I2C callback
+                        sha256UpdateByte(&dev->shaPending, data[0]);
+                    } else {
+                        sha256Update(&dev->shaPending, data, take);
+                    }
+                } else if (pos < MAX_PACKET_SIZE) {
+                    memcpy(dev->commandPacket + pos, data,
+                           pos + take > MAX_PACKET_SIZE ? (size_t)MAX_PACKET_SIZE - pos : take);
+                }
+                dev->packetPos = pos + take;
+                if (dev->packetPos == 6) {  // Opcode and parameters are in
+                    beginShaStream(dev);
+                }
+                if (dev->packetPos == end) {
+                    dev->busState = BUS_CRC;
+                }
+                break;
+            }
+
+            case BUS_CRC:
+                if (dev->trace) {
+                    dev->tracePacket[dev->packetPos] = data[0];
+                }
+                if (dev->packetPos++ == dev->commandPacket[1] - 1) {
+                    dev->packetCRCLow = data[0];
+                } else {
+                    dev->busState = BUS_WORD_ADDRESS;
+                    finishPacket(dev, dev->packetCRCLow | (data[0] << 8));
+                }
+                break;
+
+            case BUS_DISCARD:
+                take = len;
+                break;
+        }
+        data += take;
+        len -= take;
+    }
+}
+
+void atecc608_write_byte(ATECC608 *dev, uint8_t byte) {
+    atecc608_write(dev, &byte, 1);
+}
+
+// Accepts or rejects a packet whose last byte just arrived
+static void finishPacket(ATECC608 *dev, uint16_t crc) {
+    uint8_t count = dev->commandPacket[1];
+    bool streamed = dev->shaStreaming;
+    dev->shaStreaming = false;
+    dev->packetPos = 0;
+    if (crc != crc_final(dev->packetCRC)) {
+        dev->stats.crcErrors++;
+        setStatus(dev, STATUS_CRC_ERROR);
+    } else if (streamed) {
+        finishShaStream(dev, count - 7);
+    } else if (count >= MAX_PACKET_SIZE) {
+        setStatus(dev, STATUS_PARSE_ERROR);
+    } else {
+        processCommand(dev);
+    }
+    if (dev->trace) {
+        traceRecord(dev, count);
+    }
+}
+
+// Runs a command that did not come over the bus. The packet is laid out as
+// processCommand() expects but gets no CRC, nothing checks it on this path.
+static bool sendCommand(ATECC608 *dev, uint8_t command, uint8_t p1, uint16_t p2, const uint8_t *data, uint8_t dataLen) {
+    if (dataLen > MAX_PACKET_SIZE - 8) {
+        return false;
+    }
+    uint8_t count = 7 + dataLen;
+    dev->commandPacket[0] = CMD_COMMAND;
+    dev->commandPacket[1] = count;
+    dev->commandPacket[2] = command;
+    dev->commandPacket[3] = p1;
+    dev->commandPacket[4] = p2 & 0xFF;
+    dev->commandPacket[5] = p2 >> 8;
+    if (data && dataLen > 0) {
+        memcpy(&dev->commandPacket[6], data, dataLen);
+    }
+    processCommand(dev);
+    return true;
+}
+
+static void cmdRandom(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len) {
+    generateRandomNumber(dev, dev->responsePacket + 1, 32);
+    setResponse(dev, dev->responsePacket + 1, 32);
+}
+
+// Random mode returns 32 random bytes and sets TempKey to
+// SHA-256(RandOut || NumIn || 0x16 || mode || 0x00). Pass-through loads 32 or
+// 64 host bytes into TempKey, the message digest buffer or the alternate key
+// buffer. The EEPROM RNG seed is not modelled, so both random modes behave
+// the same.
+static void cmdNonce(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len) {
+    uint8_t target = mode & NONCE_MODE_TARGET_MASK;
+    switch (mode & NONCE_MODE_MASK) {
+        case NONCE_MODE_SEED_UPDATE:
+        case NONCE_MODE_NO_SEED_UPDATE: {
+            if (len != 20 || target != NONCE_MODE_TARGET_TEMPKEY || (mode & NONCE_MODE_INPUT_64)) {
+                setStatus(dev, STATUS_PARSE_ERROR);
+                return;
+            }
+            uint8_t *rand_out = dev->responsePacket + 1;
+            uint8_t message[55];
+            generateRandomNumber(dev, rand_out, 32);
+            memcpy(message, rand_out, 32);
+            memcpy(message + 32, data, 20);
+            message[52] = CMD_NONCE;
+            message[53] = mode;
+            message[54] = 0x00;
+            memset(&dev->tempKey, 0, sizeof(dev->tempKey));
+            sha256(message, sizeof(message), dev->tempKey.value);
+            dev->tempKey.valid = true;
+            finishResponse(dev, 32);
+            return;
+        }
+        case NONCE_MODE_PASSTHROUGH: {
+            uint8_t size = (mode & NONCE_MODE_INPUT_64) ? 64 : 32;
+            if (len != size) {
+                setStatus(dev, STATUS_PARSE_ERROR);
+                return;
+            }
+            switch (target) {
+                case NONCE_MODE_TARGET_TEMPKEY:
+                    memset(&dev->tempKey, 0, sizeof(dev->tempKey));
+                    memcpy(dev->tempKey.value, data, size);
+                    dev->tempKey.sourceFlag = true;
+                    dev->tempKey.valid = true;
+                    break;
+                case NONCE_MODE_TARGET_MSGDIGBUF:
+                    memcpy(dev->msgDigBuf, data, size);
+                    break;
+                default:
+                    if (size != 32) {
+                        setStatus(dev, STATUS_PARSE_ERROR);
+                        return;
+                    }
+                    memcpy(dev->altKeyBuf, data, 32);
+                    break;
+            }
+            setStatus(dev, STATUS_SUCCESS);
+            return;
+        }
+        default:
+            setStatus(dev, STATUS_PARSE_ERROR);
+            return;
+    }
+}
+
+static void cmdGenKey(ATECC608 *dev, uint8_t mode, uint16_t key_id, const uint8_t *data, uint8_t len) {
+    uint8_t *public_key = dev->responsePacket + 1;
+    if ((mode & GENKEY_MODE_PRIVATE) && !generatePrivateKey(dev, key_id, KEY_TYPE_P256)) {
+        setStatus(dev, STATUS_EXECUTION_ERROR);
+        return;
+    }
+    if (!computePublicKey(dev, key_id, public_key)) {
+        setStatus(dev, STATUS_EXECUTION_ERROR);
+        return;
+    }
+    setResponse(dev, public_key, 64);
+}
+
+// Signs the digest in TempKey or the message digest buffer; internal
+// messages (GenDig) are not modelled
+static void cmdSign(ATECC608 *dev, uint8_t mode, uint16_t key_id, const uint8_t *data, uint8_t len) {
+    uint8_t *signature = dev->responsePacket + 1;
+    if (!(mode & SIGN_MODE_EXTERNAL)) {
+        setStatus(dev, STATUS_PARSE_ERROR);
+        return;
+    }
+    const uint8_t *digest = messageDigest(dev, mode);
+    if (!digest || !signDigest(dev, key_id, digest, signature)) {
+        setStatus(dev, STATUS_EXECUTION_ERROR);
+        return;
+    }
+    dev->tempKey.valid = false;
+    setResponse(dev, signature, 64);
+}
+
+static void cmdVerify(ATECC608 *dev, uint8_t mode, uint16_t key_id, const uint8_t *data, uint8_t len) {
+    uint8_t verify_mode = mode & VERIFY_MODE_MASK;
+    if (verify_mode == VERIFY_MODE_STORED) {
+        if (len != 64) {
+            setStatus(dev, STATUS_PARSE_ERROR);
+            return;
+        }
+        if (key_id >= SLOT_COUNT) {
+            setStatus(dev, STATUS_EXECUTION_ERROR);
+            return;
+        }
+    } else if (verify_mode == VERIFY_MODE_EXTERNAL) {
+        if (len != 128 || key_id != KEY_TYPE_P256) {
+            setStatus(dev, STATUS_PARSE_ERROR);
+            return;
+        }
+    } else {
+        setStatus(dev, STATUS_PARSE_ERROR);
+        return;
+    }
+    const uint8_t *digest = messageDigest(dev, mode);
+    if (!digest) {
+        setStatus(dev, STATUS_EXECUTION_ERROR);
+        return;
+    }
+    dev->tempKey.valid = false;
+
+    bool verified = verify_mode == VERIFY_MODE_STORED
+        ? verifyStoredSignature(dev, key_id, digest, data)
+        : verifySignature(digest, data, data + 64);
+    setStatus(dev, verified ? STATUS_SUCCESS : STATUS_VERIFY_FAILED);
+}
+
+// ECDH against the public key X || Y in data, with the private key taken
+// from slot key_id or from TempKey. The premaster secret goes to the
+// response (clear or encrypted), TempKey, or a slot: key_id | 1 when the
+// private key came from a slot, otherwise key_id itself. A slot target obeys
+// the same permissions as Write. Compatibility mode picks the slot or the
+// clear response from the slot's SlotConfig.
+static void cmdEcdh(ATECC608 *dev, uint8_t mode, uint16_t key_id, const uint8_t *data, uint8_t len) {
+    bool from_tempkey = mode & ECDH_MODE_SOURCE_TEMPKEY;
+    uint8_t copy = mode & ECDH_MODE_COPY_MASK;
+    uint8_t private_key[32];
+    uint8_t secret[32];
+    if (key_id >= SLOT_COUNT) {
+        setStatus(dev, STATUS_PARSE_ERROR);
+        return;
+    }
+    if (from_tempkey) {
+        if (!dev->tempKey.valid) {
+            setStatus(dev, STATUS_EXECUTION_ERROR);
+            return;
+        }
+        memcpy(private_key, dev->tempKey.value, 32);
+    } else if (!(slotConfig(dev, key_id) & SLOT_CONFIG_ECDH_ALLOWED) ||
+               !read(dev, ZONE_DATA, slotAddress(dev, key_id), private_key, 32)) {
+        setStatus(dev, STATUS_EXECUTION_ERROR);
+        return;
+    }
+    if (!eccSharedSecret(private_key, data, secret)) {
+        setStatus(dev, STATUS_EXECUTION_ERROR);
+        return;
+    }
+
+    uint8_t target_slot = from_tempkey ? key_id : (key_id | 1);
+    if (copy == ECDH_MODE_COPY_COMPATIBLE) {
+        copy = !from_tempkey && (slotConfig(dev, key_id) & SLOT_CONFIG_ECDH_TO_SLOT)
+            ? ECDH_MODE_COPY_SLOT : ECDH_MODE_COPY_OUTPUT_BUFFER;
+    }
+    switch (copy) {
+        case ECDH_MODE_COPY_SLOT:
+            if (slotSize(dev, target_slot) < 32 || !slotWritable(dev, target_slot) ||
+                !write(dev, ZONE_DATA, slotAddress(dev, target_slot), secret, 32)) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            setStatus(dev, STATUS_SUCCESS);
+            return;
+        case ECDH_MODE_COPY_TEMPKEY:
+            memset(&dev->tempKey, 0, sizeof(dev->tempKey));
+            memcpy(dev->tempKey.value, secret, 32);
+            dev->tempKey.keyId = key_id;
+            dev->tempKey.valid = true;
+            setStatus(dev, STATUS_SUCCESS);
+            return;
+        default:
+            break;
+    }
+
+    uint8_t *out = dev->responsePacket + 1;
+    if (!(mode & ECDH_MODE_OUTPUT_ENCRYPTED)) {
+        memcpy(out, secret, 32);
+        finishResponse(dev, 32);
+        return;
+    }
+    memcpy(out, secret, 32);
+    if (!encryptOutput(dev, out, 32)) {
+        setStatus(dev, STATUS_EXECUTION_ERROR);
+        return;
+    }
+    finishResponse(dev, 64);
+}
+
+// Resolves the KDF source key. Slots and TempKey supply up to 64 bytes (a
+// smaller slot its whole size), the upper TempKey half and the alternate key
+// buffer 32.
+static const uint8_t *kdfSourceKey(ATECC608 *dev, uint8_t mode, uint8_t slot, uint8_t *key_len) {
+    switch (mode & KDF_MODE_SOURCE_MASK) {
+        case KDF_MODE_SOURCE_TEMPKEY:
+            *key_len = 64;
+            return dev->tempKey.valid ? dev->tempKey.value : NULL;
+        case KDF_MODE_SOURCE_TEMPKEY_UP:
+            *key_len = 32;
+            return dev->tempKey.valid ? dev->tempKey.value + 32 : NULL;
+        case KDF_MODE_SOURCE_SLOT:
+            if (slot >= SLOT_COUNT) {
+                return NULL;
+            }
+            *key_len = slotSize(dev, slot) < 64 ? slotSize(dev, slot) : 64;
+            return dev->slotData[slot];
+        default:
+            *key_len = 32;
+            return dev->altKeyBuf;
+    }
+}
+
+// HMAC-SHA256 from a context that has only absorbed the key pads
+static void kdfHmac(const HmacSha256Context *keyed, const uint8_t *a, size_t a_len,
+                    const uint8_t *b, size_t b_len, uint8_t *mac) {
+    HmacSha256Context ctx = *keyed;
+    hmacSha256Update(&ctx, a, a_len);
+    if (b_len) {
+        hmacSha256Update(&ctx, b, b_len);
+    }
+    hmacSha256Final(&ctx, mac);
+}
+
+// KDF with param2 = source slot (low byte) and target slot (high byte), and
+// data = 4-byte little-endian details followed by the message.
+//  - PRF is TLS 1.2 P_SHA256 keyed with 16-64 source bytes, giving 32 or 64
+//    bytes. The key pads are absorbed once and every block reuses them.
+//  - HKDF is one HMAC-SHA256 (extract) of the message under a 32-byte key,
+//    or under zeros.
+//  - AES encrypts a 16-byte message with one 16-byte quarter of the source.
+static void cmdKdf(ATECC608 *dev, uint8_t mode, uint16_t key_id, const uint8_t *data, uint8_t len) {
+    uint32_t details = loadLe32(data);
+    const uint8_t *message = data + 4;
+    uint8_t message_len = details >> 24;
+    uint8_t key_len;
+    const uint8_t *key = kdfSourceKey(dev, mode, key_id & 0xFF, &key_len);
+    uint8_t result[64];
+    uint8_t result_len;
+    if (!key) {
+        setStatus(dev, STATUS_EXECUTION_ERROR);
+        return;
+    }
+
+    switch (mode & KDF_MODE_ALG_MASK) {
+        case KDF_MODE_ALG_PRF: {
+            uint8_t prf_key_len = 16 * ((details & KDF_DETAILS_PRF_KEY_LEN_MASK) + 1);
+            if (message_len != len - 4 || prf_key_len > key_len) {
+                setStatus(dev, STATUS_PARSE_ERROR);
+                return;
+            }
+            result_len = (details & KDF_DETAILS_PRF_TARGET_LEN_64) ? 64 : 32;
+            HmacSha256Context keyed;
+            uint8_t a[32];
+            hmacSha256Init(&keyed, key, prf_key_len);
+            kdfHmac(&keyed, message, message_len, NULL, 0, a);  // A(1)
+            for (uint8_t block = 0; block < result_len; block += 32) {
+                if (block) {
+                    kdfHmac(&keyed, a, 32, NULL, 0, a);
+                }
+                kdfHmac(&keyed, a, 32, message, message_len, result + block);
+            }
+            break;
+        }
+        case KDF_MODE_ALG_HKDF: {
+            static const uint8_t zero_key[32];
+            const uint8_t *hkdf_message;
+            switch (details & KDF_DETAILS_HKDF_MSG_LOC_MASK) {
+                case KDF_DETAILS_HKDF_MSG_LOC_INPUT:
+                    if (message_len != len - 4) {
+                        setStatus(dev, STATUS_PARSE_ERROR);
+                        return;
+                    }
+                    hkdf_message = message;
+                    break;
+                case KDF_DETAILS_HKDF_MSG_LOC_TEMPKEY:
+                    if (!dev->tempKey.valid || message_len > 64) {
+                        setStatus(dev, STATUS_EXECUTION_ERROR);
+                        return;
+                    }
+                    hkdf_message = dev->tempKey.value;
+                    break;
+                case KDF_DETAILS_HKDF_MSG_LOC_SLOT: {
+                    uint8_t slot = (details >> 8) & 0x0F;
+                    if (message_len > slotSize(dev, slot)) {
+                        setStatus(dev, STATUS_EXECUTION_ERROR);
+                        return;
+                    }
+                    hkdf_message = dev->slotData[slot];
+                    break;
+                }
+                default:
+                    setStatus(dev, STATUS_PARSE_ERROR);
+                    return;
+            }
+            HmacSha256Context ctx;
+            hmacSha256Init(&ctx, (details & KDF_DETAILS_HKDF_ZERO_KEY) ? zero_key : key, 32);
+            hmacSha256Update(&ctx, hkdf_message, message_len);
+            hmacSha256Final(&ctx, result);
+            result_len = 32;
+            break;
+        }
+        case KDF_MODE_ALG_AES: {
+            uint8_t offset = 16 * (details & KDF_DETAILS_AES_KEY_LOC_MASK);
+            if (len != 4 + 16 || offset + 16 > key_len) {
+                setStatus(dev, STATUS_PARSE_ERROR);
+                return;
+            }
+            Aes128Key schedule;
+            aes128ExpandKey(&schedule, key + offset);
+            aes128Encrypt(&schedule, message, result);
+            result_len = 16;
+            break;
+        }
+        default:
+            setStatus(dev, STATUS_PARSE_ERROR);
+            return;
+    }
+
+    uint8_t *out = dev->responsePacket + 1;
+    switch (mode & KDF_MODE_TARGET_MASK) {
+        case KDF_MODE_TARGET_TEMPKEY:
+            memset(&dev->tempKey, 0, sizeof(dev->tempKey));
+            memcpy(dev->tempKey.value, result, result_len);
+            dev->tempKey.valid = true;
+            break;
+        case KDF_MODE_TARGET_TEMPKEY_UP:
+            if (result_len > 32 || !dev->tempKey.valid) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            memcpy(dev->tempKey.value + 32, result, result_len);
+            break;
+        case KDF_MODE_TARGET_SLOT: {
+            uint8_t slot = key_id >> 8;
+            if (slot >= SLOT_COUNT || result_len > slotSize(dev, slot) || !slotWritable(dev, slot) ||
+                !write(dev, ZONE_DATA, slotAddress(dev, slot), result, result_len > 32 ? 32 : result_len) ||
+                (result_len > 32 &&
+                 !write(dev, ZONE_DATA, slotAddress(dev, slot) + 32, result + 32, result_len - 32))) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            break;
+        }
+        case KDF_MODE_TARGET_ALTKEYBUF:
+            if (result_len > 32) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            memcpy(dev->altKeyBuf, result, result_len);
+            break;
+        case KDF_MODE_TARGET_OUTPUT:
+            memcpy(out, result, result_len);
+            finishResponse(dev, result_len);
+            return;
+        case KDF_MODE_TARGET_OUTPUT_ENC:
+            memcpy(out, result, result_len);
+            if (!encryptOutput(dev, out, result_len)) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            finishResponse(dev, result_len + 32);
+            return;
+        default:
+            setStatus(dev, STATUS_PARSE_ERROR);
+            return;
+    }
+    setStatus(dev, STATUS_SUCCESS);
+}
+
+// Config reads are always allowed. Data and OTP can only be read once the
+// data zone is locked, and secret slots never in the clear. The 4- and
+// 32-byte cases copy straight from the zone into the response.
+static void cmdRead(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len) {
+    uint8_t zone = mode & ZONE_MASK;
+    uint8_t size = (mode & ZONE_MODE_32_BYTES) ? 32 : 4;
+    uint16_t address;
+    if (!zoneAddress(dev, zone, param2, size, &address)) {
+        setStatus(dev, STATUS_PARSE_ERROR);
+        return;
+    }
+
+    const uint8_t *source;
+    switch (zone) {
+        case ZONE_CONFIG:
+            source = dev->configZone;
+            break;
+        case ZONE_OTP:
+            if (!isDataAndOTPLocked(dev)) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            source = dev->otpZone;
+            break;
+        default: {
+            uint8_t slot = (param2 >> 3) & 0x0F;
+            if (!isDataAndOTPLocked(dev) || (slotConfig(dev, slot) & SLOT_CONFIG_IS_SECRET)) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            source = dev->slotData[slot];
+            address -= slotAddress(dev, slot);
+            break;
+        }
+    }
+
+    uint8_t *out = dev->responsePacket + 1;
+    if (size == 32) {
+        memcpy(out, source + address, 32);
+    } else {
+        memcpy(out, source + address, 4);
+    }
+    finishResponse(dev, size);
+}
+
+// Only clear-text writes are supported. Config bytes 0-15 and 84-87 cannot be
+// changed with Write and are left as they are. Before the data zone is locked
+// any slot and the OTP zone can be written; afterwards only the slots
+// slotWritable() allows.
+static void cmdWrite(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len) {
+    uint8_t zone = mode & ZONE_MASK;
+    uint8_t size = (mode & ZONE_MODE_32_BYTES) ? 32 : 4;
+    uint16_t address;
+    if (len != size || !zoneAddress(dev, zone, param2, size, &address)) {
+        setStatus(dev, STATUS_PARSE_ERROR);
+        return;
+    }
+    if (mode & ZONE_MODE_ENCRYPTED) {
+        setStatus(dev, STATUS_EXECUTION_ERROR);
+        return;
+    }
+
+    switch (zone) {
+        case ZONE_CONFIG: {
+            if (isConfigLocked(dev)) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            uint8_t *dest = pageWritable(dev, PAGE_CONFIG);
+            if (!dest) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            dest += address;
+            for (uint8_t i = 0; i < size; i++) {
+                uint16_t at = address + i;
+                if (at >= 16 && (at < 84 || at > 87)) {
+                    dest[i] = data[i];
+                }
+            }
+            markDirty(dev, ZONE_CONFIG, address, size);
+            dev->infoStaleKeys = 0xFFFF;  // KeyConfig decides what KeyValid reports
+            break;
+        }
+        case ZONE_OTP:
+            if (!isConfigLocked(dev) || isDataAndOTPLocked(dev) || !write(dev, ZONE_OTP, address, data, size)) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            break;
+        default: {
+            if (!slotWritable(dev, (param2 >> 3) & 0x0F) || !write(dev, ZONE_DATA, address, data, size)) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            break;
+        }
+    }
+    setStatus(dev, STATUS_SUCCESS);
+}
+
+// The summary in param2 is the CRC of the zone contents being locked: the
+// whole config zone, or the data zone followed by the OTP zone.
+static void cmdLock(ATECC608 *dev, uint8_t mode, uint16_t summary, const uint8_t *data, uint8_t len) {
+    uint16_t crc;
+    switch (mode & LOCK_MODE_ZONE_MASK) {
+        case LOCK_MODE_CONFIG:
+            if (isConfigLocked(dev)) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            crc = calculateCRC(dev->configZone, CONFIG_SIZE);
+            break;
+        case LOCK_MODE_DATA: {
+            if (!isConfigLocked(dev) || isDataAndOTPLocked(dev)) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            uint16_t state = CRC_INIT;
+            for (uint8_t slot = 0; slot < SLOT_COUNT; slot++) {  // The slots tile the data zone in order
+                for (uint16_t i = 0; i < slotSize(dev, slot); i++) {
+                    state = crc_update(state, dev->slotData[slot][i]);
+                }
+            }
+            for (size_t i = 0; i < OTP_SIZE; i++) {
+                state = crc_update(state, dev->otpZone[i]);
+            }
+            crc = crc_final(state);
+            break;
+        }
+        default:
+            setStatus(dev, STATUS_PARSE_ERROR);
+            return;
+    }
+    if (!(mode & LOCK_MODE_NO_CRC) && crc != summary) {
+        setStatus(dev, STATUS_EXECUTION_ERROR);
+        return;
+    }
+    bool locked = (mode & LOCK_MODE_ZONE_MASK) == LOCK_MODE_CONFIG
+        ? lockConfigZone(dev) : lockDataAndOTPZones(dev);
+    setStatus(dev, locked ? STATUS_SUCCESS : STATUS_EXECUTION_ERROR);
+}
+
+static void cmdSha(ATECC608 *dev, uint8_t mode, uint16_t key_id, const uint8_t *data, uint8_t len) {
+    uint8_t *digest = dev->responsePacket + 1;
+    uint8_t key[32];
+    switch (mode & SHA_MODE_MASK) {
+        case SHA_MODE_START:
+            sha256Init(&dev->sha.inner);
+            dev->shaContext = SHA_CONTEXT_SHA;
+            break;
+        case SHA_MODE_HMAC_START:
+            if (key_id >= SLOT_COUNT || !read(dev, ZONE_DATA, slotAddress(dev, key_id), key, 32)) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            hmacSha256Init(&dev->sha, key, 32);
+            dev->shaContext = SHA_CONTEXT_HMAC;
+            break;
+        case SHA_MODE_UPDATE:
+            if (len == 0 || len % 64 != 0) {
+                setStatus(dev, STATUS_PARSE_ERROR);
+                return;
+            }
+            if (dev->shaContext == SHA_CONTEXT_NONE) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            sha256Update(&dev->sha.inner, data, len);
+            break;
+        case SHA_MODE_END:
+        case SHA_MODE_HMAC_END: {
+            uint8_t expected = (mode & SHA_MODE_MASK) == SHA_MODE_END ? SHA_CONTEXT_SHA : SHA_CONTEXT_HMAC;
+            if (len > 63) {
+                setStatus(dev, STATUS_PARSE_ERROR);
+                return;
+            }
+            if (dev->shaContext != expected) {
+                setStatus(dev, STATUS_EXECUTION_ERROR);
+                return;
+            }
+            sha256Update(&dev->sha.inner, data, len);
+            if (expected == SHA_CONTEXT_HMAC) {
+                hmacSha256Final(&dev->sha, digest);
+            } else {
+                sha256Final(&dev->sha.inner, digest);
+            }
+            dev->shaContext = SHA_CONTEXT_NONE;
+            memset(&dev->tempKey, 0, sizeof(dev->tempKey));
+            memcpy(dev->tempKey.value, digest, 32);
+            dev->tempKey.sourceFlag = true;
+            dev->tempKey.valid = true;
+            setResponse(dev, digest, 32);
+            return;
+        }
+        default:
+            setStatus(dev, STATUS_PARSE_ERROR);
+            return;
+    }
+    setStatus(dev, STATUS_SUCCESS);
+}
+
+// SHA Update payloads are hashed straight off the bus into a copy of the
+// context, one block at a time, so they are neither buffered nor bounded by
+// MAX_PACKET_SIZE. The copy only replaces the live context after the CRC
+// has been checked.
+static void beginShaStream(ATECC608 *dev) {
+    if (dev->commandPacket[2] == CMD_SHA &&
+        (dev->commandPacket[3] & SHA_MODE_MASK) == SHA_MODE_UPDATE &&
+        dev->shaContext != SHA_CONTEXT_NONE) {
+        dev->shaPending = dev->sha.inner;
+        dev->shaStreaming = true;
+    }
+}
+
+// The hashing itself happened byte by byte on the bus, so the host time
+// recorded here is only the commit of the pending context
+static void finishShaStream(ATECC608 *dev, uint8_t len) {
+    uint64_t start = hostNanos();
+    if (len == 0 || len % 64 != 0) {
+        setStatus(dev, STATUS_PARSE_ERROR);
+    } else {
+        dev->sha.inner = dev->shaPending;
+        setStatus(dev, STATUS_SUCCESS);
+    }
+    simulateExecutionTime(dev, commandLatency(dev, CMD_SHA));
+    recordCommand(dev, LAT_SHA, start);
+}
+
+// The 32-byte message Sign and Verify operate on, or NULL if TempKey is
+// selected but not valid
+static const uint8_t *messageDigest(ATECC608 *dev, uint8_t mode) {
+    if (mode & MESSAGE_SOURCE_MSGDIGBUF) {
+        return dev->msgDigBuf;
+    }
+    return dev->tempKey.valid ? dev->tempKey.value : NULL;
+}
+
+static bool signDigest(ATECC608 *dev, uint8_t key_id, const uint8_t *digest, uint8_t *signature) {
+    uint8_t private_key[32];
+    uint8_t nonce[32];
+    if (key_id >= 16) {
+        dev->lastError = 8;
+        return false;
+    }
+    if (!read(dev, ZONE_DATA, slotAddress(dev, key_id), private_key, 32) || !eccIsValidPrivateKey(private_key)) {
+        return false;
+    }
+    do {
+        generateRandomNumber(dev, nonce, 32);
+    } while (!eccSign(private_key, digest, nonce, signature));
+    return true;
+}
+
+static bool verifySignature(const uint8_t *digest, const uint8_t *signature, const uint8_t *public_key) {
+    EccAffine q;
+    EccWindowTable table;
+    if (!eccLoadPublicKey(&q, public_key)) {
+        return false;
+    }
+    eccPrecompute(&table, &q);
+    return eccVerify(&table, digest, signature);
+}
+
+// Like verifySignature() for the public key stored in key_id, reusing the
+// slot's cached window table
+static bool verifyStoredSignature(ATECC608 *dev, uint8_t key_id, const uint8_t *digest, const uint8_t *signature) {
+    SlotCache *cache = &dev->slotCache[key_id];
+    if (!cache->verifyTableValid) {
+        uint8_t public_key[64];
+        EccAffine q;
+        if (!readPublicKey(dev, key_id, public_key) || !eccLoadPublicKey(&q, public_key)) {
+            return false;
+        }
+        if (!cache->verifyTable) {
+            cache->verifyTable = malloc(sizeof(EccWindowTable));
+            if (!cache->verifyTable) {
+                return false;
+            }
+        }
+        eccPrecompute(cache->verifyTable, &q);
+        cache->verifyTableValid = true;
+    }
+    return eccVerify(cache->verifyTable, digest, signature);
+}
+
+// Verifies the 96-byte digest || signature in image against the public key
+// stored in key_id. The last image that verified is kept until the slot is
+// written, so booting the same firmware again is a compare.
+static bool verifyBootImage(ATECC608 *dev, uint8_t key_id, const uint8_t *image) {
+    SlotCache *cache = &dev->slotCache[key_id];
+    if (cache->bootImageValid && memcmp(cache->bootImage, image, 96) == 0) {
+        dev->stats.secureBootHits++;
+        return true;
+    }
+    if (!verifyStoredSignature(dev, key_id, image, image + 32)) {
+        return false;
+    }
+    if (!cache->bootImage) {
+        cache->bootImage = malloc(96);
+        if (!cache->bootImage) {
+            return true;  // Verified, just not cached
+        }
+    }
+    memcpy(cache->bootImage, image, 96);
+    cache->bootImageValid = true;
+    return true;
+}
+
+static bool read(ATECC608 *dev, uint8_t zone, uint16_t address, uint8_t *data, uint8_t len) {
+    uint8_t page;
+    uint16_t offset;
+    if (len > 32) {
+        dev->lastError = 1;
+        return false;
+    }
+    if (!zonePage(dev, zone, address, len, &page, &offset)) {
+        return false;
+    }
+    memcpy(data, *pageEntry(dev, page) + offset, len);
+    return true;
+}
+
+static bool write(ATECC608 *dev, uint8_t zone, uint16_t address, const uint8_t *data, uint8_t len) {
+    uint8_t page;
+    uint16_t offset;
+    if (len > 32) {
+        dev->lastError = 1;
+        return false;
+    }
+    if (!zonePage(dev, zone, address, len, &page, &offset)) {
+        return false;
+    }
+    uint8_t *dest = pageWritable(dev, page);
+    if (!dest) {
+        dev->lastError = 4;
+        return false;
+    }
+    memcpy(dest + offset, data, len);
+    markDirty(dev, zone & 0x03, address, len);
+    if ((zone & 0x03) == ZONE_DATA) {
+        invalidateSlotCache(dev, address, len);
+    }
+    return true;
+}
+
+// Decodes the param2 address of Read and Write into a byte offset. Config
+// and OTP use block in bits 3-7 and 4-byte word in bits 0-2; the data zone
+// adds the slot in bits 3-6 and moves the block to bits 8-15, and the slot's
+// offset and size come from the variant. 32-byte accesses ignore the word.
+// The access has to stay within its zone or slot.
+static bool zoneAddress(ATECC608 *dev, uint8_t zone, uint16_t param2, uint8_t size, uint16_t *address) {
+    uint16_t word = size == 32 ? 0 : (param2 & 0x07) * 4;
+    uint16_t offset;
+    uint16_t limit;
+    switch (zone) {
+        case ZONE_CONFIG: offset = ((param2 >> 3) & 0x1F) * 32 + word; limit = CONFIG_SIZE; break;
+        case ZONE_OTP: offset = ((param2 >> 3) & 0x1F) * 32 + word; limit = OTP_SIZE; break;
+        case ZONE_DATA: {
+            const SlotLayout *slot = &chipVariants[dev->variant].slots[(param2 >> 3) & 0x0F];
+            uint16_t in_slot = (param2 >> 8) * 32 + word;
+            if (in_slot + size > slot->size) {
+                return false;
+            }
+            offset = slot->offset + in_slot;
+            limit = DATA_SIZE;
+            break;
+        }
+        default: return false;
+    }
+    if (offset + size > limit) {
+        return false;
+    }
+    *address = offset;
+    return true;
+}
+
+// SlotConfig is two little-endian bytes per slot starting at config byte 20
+static uint16_t slotConfig(ATECC608 *dev, uint8_t slot) {
+    return dev->configZone[20 + 2 * slot] | (dev->configZone[21 + 2 * slot] << 8);
+}
+
+static uint16_t keyConfig(ATECC608 *dev, uint8_t slot) {
+    return dev->configZone[96 + 2 * slot] | (dev->configZone[97 + 2 * slot] << 8);
+}
+
+// Data zone offset and size of a slot in the device's variant
+static uint16_t slotAddress(ATECC608 *dev, uint8_t slot) {
+    return chipVariants[dev->variant].slots[slot].offset;
+}
+
+static uint16_t slotSize(ATECC608 *dev, uint8_t slot) {
+    return chipVariants[dev->variant].slots[slot].size;
+}
+
+static bool lockConfigZone(ATECC608 *dev) {
+    uint8_t *config = pageWritable(dev, PAGE_CONFIG);
+    if (!config) {
+        return false;
+    }
+    config[87] = 0x00;  // Set the lock byte
+    markDirty(dev, ZONE_CONFIG, 87, 1);
+    return true;
+}
+
+static bool lockDataAndOTPZones(ATECC608 *dev) {
+    uint8_t *config = pageWritable(dev, PAGE_CONFIG);
+    if (!config) {
+        return false;
+    }
+    config[86] = 0x00;  // Set the lock byte
+    markDirty(dev, ZONE_CONFIG, 86, 1);
+    return true;
+}
+
+// Golden images in EEPROM layout, one per variant, built on first use. When
+// ATECC608_GOLDEN_IMAGE names an EEPROM image file of the variant's length,
+// that file is the golden image, otherwise the factory state is.
+static const uint8_t *goldenImage(uint8_t variant) {
+    uint8_t *image = goldenImages[variant];
+    if (goldenSource[variant] != GOLDEN_NONE) {
+        return image;
+    }
+    goldenSource[variant] = GOLDEN_FACTORY;
+    loadDefaultConfig(image, &chipVariants[variant]);
+    const char *path = getenv("ATECC608_GOLDEN_IMAGE");
+    FILE *file = path && *path ? fopen(path, "rb") : NULL;
+    if (file) {
+        uint8_t bytes[EEPROM_SIZE + 1];
+        size_t len = fread(bytes, 1, sizeof(bytes), file);
+        fclose(file);
+        if (len == eepromBlocks(variant) * EEPROM_BLOCK_SIZE) {
+            memcpy(image, bytes, len);
+            goldenSource[variant] = GOLDEN_FILE;
+        }
+    }
+    return image;
+}
+
+static const uint8_t **pageEntry(ATECC608 *dev, uint8_t page) {
+    switch (page) {
+        case PAGE_CONFIG: return &dev->configZone;
+        case PAGE_OTP: return &dev->otpZone;
+        default: return &dev->slotData[page - PAGE_SLOT];
+    }
+}
+
+// Range of the EEPROM image layout a page covers
+static uint16_t pageOffset(ATECC608 *dev, uint8_t page) {
+    switch (page) {
+        case PAGE_CONFIG: return 0;
+        case PAGE_OTP: return CONFIG_SIZE;
+        default: return CONFIG_SIZE + OTP_SIZE + slotAddress(dev, page - PAGE_SLOT);
+    }
+}
+
+static uint16_t pageSize(ATECC608 *dev, uint8_t page) {
+    switch (page) {
+        case PAGE_CONFIG: return CONFIG_SIZE;
+        case PAGE_OTP: return OTP_SIZE;
+        default: return slotSize(dev, page - PAGE_SLOT);
+    }
+}
+
+// Gives the device its own copy of a page before it is written. NULL when
+// the copy cannot be allocated.
+static uint8_t *pageWritable(ATECC608 *dev, uint8_t page) {
+    const uint8_t **entry = pageEntry(dev, page);
+    if (dev->ownPages & (1u << page)) {
+        return (uint8_t *)*entry;  // Private copies are the device's own
+    }
+    uint8_t *copy = malloc(pageSize(dev, page));
+    if (!copy) {
+        return NULL;
+    }
+    memcpy(copy, *entry, pageSize(dev, page));
+    *entry = copy;
+    dev->ownPages |= 1u << page;
+    return copy;
+}
+
+// Drops every private copy and points all pages back at the golden image
+static void sharePages(ATECC608 *dev) {
+    const uint8_t *golden = goldenImage(dev->variant);
+    for (uint8_t page = 0; page < PAGE_COUNT; page++) {
+        const uint8_t **entry = pageEntry(dev, page);
+        if (dev->ownPages & (1u << page)) {
+            free((uint8_t *)*entry);
+        }
+        *entry = golden + pageOffset(dev, page);
+    }
+    dev->ownPages = 0;
+}
+
+// Replaces the zones with an EEPROM layout image. Pages that match the
+// golden image are shared, private copies are reused for the others. The
+// pages have to be laid out for the device's current variant.
+static bool loadImage(ATECC608 *dev, const uint8_t *image) {
+    const uint8_t *golden = goldenImage(dev->variant);
+    for (uint8_t page = 0; page < PAGE_COUNT; page++) {
+        uint16_t offset = pageOffset(dev, page);
+        uint16_t size = pageSize(dev, page);
+        if (memcmp(image + offset, golden + offset, size) == 0) {
+            if (dev->ownPages & (1u << page)) {
+                const uint8_t **entry = pageEntry(dev, page);
+                free((uint8_t *)*entry);
+                *entry = golden + offset;
+                dev->ownPages &= ~(1u << page);
+            }
+            continue;
+        }
+        uint8_t *dest = pageWritable(dev, page);
+        if (!dest) {
+            return false;
+        }
+        memcpy(dest, image + offset, size);
+    }
+    return true;
+}
+
+// Copies a range of the EEPROM image layout out of the pages. Bytes past the
+// last slot read as zero.
+static void imageRead(ATECC608 *dev, uint16_t offset, uint8_t *out, uint16_t len) {
+    memset(out, 0, len);
+    for (uint8_t page = 0; page < PAGE_COUNT; page++) {
+        uint16_t start = pageOffset(dev, page);
+        uint16_t end = start + pageSize(dev, page);
+        uint16_t from = offset > start ? offset : start;
+        uint16_t to = offset + len < end ? offset + len : end;
+        if (from < to) {
+            memcpy(out + (from - offset), *pageEntry(dev, page) + (from - start), to - from);
+        }
+    }
+}
+
+// Resolves a zone range to its page and the offset within it. A data zone
+// range has to stay inside one slot.
+static bool zonePage(ATECC608 *dev, uint8_t zone, uint16_t address, uint8_t len, uint8_t *page, uint16_t *offset) {
+    uint16_t limit;
+    switch (zone & 0x03) {
+        case ZONE_CONFIG: *page = PAGE_CONFIG; limit = CONFIG_SIZE; break;
+        case ZONE_OTP: *page = PAGE_OTP; limit = OTP_SIZE; break;
+        case ZONE_DATA:
+            for (uint8_t slot = 0; slot < SLOT_COUNT; slot++) {
+                uint16_t start = slotAddress(dev, slot);
+                if (address >= start && address + len <= start + slotSize(dev, slot)) {
+                    *page = PAGE_SLOT + slot;
+                    *offset = address - start;
+                    return true;
+                }
+            }
+            dev->lastError = 3;
+            return false;
+        default: dev->lastError = 2; return false;
+    }
+    if (address + len > limit) {
+        dev->lastError = 3;
+        return false;
+    }
+    *offset = address;
+    return true;
+}
+
+// Persistent EEPROM. When the ATECC608_EEPROM_DIR environment variable is
+// set, each chip keeps its zones in <dir>/atecc608-<address>.bin. The image
+// is read once per reset and only the 32-byte blocks a command touched are
+// written back. A missing or short file is (re)created from the defaults.
+static void markDirty(ATECC608 *dev, uint8_t zone, uint16_t address, uint16_t len) {
+    uint8_t first = zone == ZONE_CONFIG ? EEPROM_CONFIG_BLOCK
+                  : zone == ZONE_OTP ? EEPROM_OTP_BLOCK
+                  : EEPROM_DATA_BLOCK;
+    for (uint16_t block = address / EEPROM_BLOCK_SIZE; block <= (address + len - 1) / EEPROM_BLOCK_SIZE; block++) {
+        dev->eepromDirty |= 1ull << (first + block);
+    }
+}
+
+// Blocks in the image of a variant
+static uint8_t eepromBlocks(uint8_t variant) {
+    return EEPROM_DATA_BLOCK + (chipVariants[variant].dataSize + EEPROM_BLOCK_SIZE - 1) / EEPROM_BLOCK_SIZE;
+}
+
+static void eepromOpen(ATECC608 *dev, uint8_t address) {
+    const char *dir = getenv("ATECC608_EEPROM_DIR");
+    if (!dir || !*dir) {
+        return;
+    }
+    char path[512];
+    snprintf(path, sizeof(path), "%s/atecc608-%02x.bin", dir, address);
+    dev->eeprom = fopen(path, "r+b");
+    if (!dev->eeprom) {
+        dev->eeprom = fopen(path, "w+b");
+    }
+    if (!dev->eeprom) {
+        printf("ATECC608: cannot open EEPROM image %s\n", path);
+    }
+}
+
+static void eepromLoad(ATECC608 *dev) {
+    uint8_t image[EEPROM_SIZE];
+    uint8_t blocks = eepromBlocks(dev->variant);
+    rewind(dev->eeprom);
+    if (fread(image, 1, blocks * EEPROM_BLOCK_SIZE, dev->eeprom) != blocks * EEPROM_BLOCK_SIZE) {
+        dev->eepromDirty = (1ull << blocks) - 1;  // Write the defaults out
+        eepromFlush(dev);
+        return;
+    }
+    if (!loadImage(dev, image)) {
+        printf("ATECC608: out of memory loading the EEPROM image\n");
+    }
+    dev->eepromDirty = 0;
+    invalidateSlotCache(dev, 0, DATA_SIZE);
+}
+
+// A block stays dirty until it has been written and flushed, so a failed
+// write is retried on the next flush
+static void eepromFlush(ATECC608 *dev) {
+    if (!dev->eeprom) {
+        dev->eepromDirty = 0;
+        return;
+    }
+    uint64_t dirty = dev->eepromDirty;
+    uint64_t written = 0;
+    while (dirty) {
+        uint8_t block = __builtin_ctzll(dirty);
+        dirty &= dirty - 1;
+        uint8_t bytes[EEPROM_BLOCK_SIZE];
+        imageRead(dev, block * EEPROM_BLOCK_SIZE, bytes, EEPROM_BLOCK_SIZE);
+        if (fseek(dev->eeprom, block * EEPROM_BLOCK_SIZE, SEEK_SET) == 0 &&
+            fwrite(bytes, 1, EEPROM_BLOCK_SIZE, dev->eeprom) == EEPROM_BLOCK_SIZE) {
+            written |= 1ull << block;
+        }
+    }
+    if (fflush(dev->eeprom) != 0) {
+        written = 0;
+    }
+    dev->eepromDirty &= ~written;
+    if (dev->eepromDirty) {
+        printf("ATECC608: cannot write EEPROM image, %d blocks pending\n", __builtin_popcountll(dev->eepromDirty));
+    }
+}
+
+static bool isConfigLocked(ATECC608 *dev) {
+    return dev->configZone[87] == 0x00;
+}
+
+static bool isDataAndOTPLocked(ATECC608 *dev) {
+    return dev->configZone[86] == 0x00;
+}
+
+// Whether a command may overwrite a slot in the clear: any slot between the
+// config and data zone locks, afterwards only slots whose WriteConfig is
+// Always and whose SlotLocked bit (config bytes 88-89) is still set
+static bool slotWritable(ATECC608 *dev, uint8_t slot) {
+    if (!isConfigLocked(dev)) {
+        return false;
+    }
+    if (!isDataAndOTPLocked(dev)) {
+        return true;
+    }
+    uint16_t unlocked = dev->configZone[88] | (dev->configZone[89] << 8);
+    return (slotConfig(dev, slot) >> SLOT_CONFIG_WRITE_CONFIG_SHIFT) == WRITE_CONFIG_ALWAYS &&
+           (unlocked & (1 << slot));
+}
+
+static uint8_t lockState(ATECC608 *dev) {
+    if (!isConfigLocked(dev)) {
+        return LOCK_STATE_UNLOCKED;
+    }
+    return isDataAndOTPLocked(dev) ? LOCK_STATE_LOCKED : LOCK_STATE_CONFIG_LOCKED;
+}
+
+static bool storeKey(ATECC608 *dev, uint8_t key_id, const uint8_t *key, uint8_t key_type) {
+    if (key_id >= 16) {
+        dev->lastError = 8;
+        return false;
+    }
+    return write(dev, ZONE_DATA, slotAddress(dev, key_id), key, 32);
+}
+
+static bool generatePrivateKey(ATECC608 *dev, uint8_t key_id, uint8_t key_type) {
+    uint8_t private_key[32];
+    do {
+        generateRandomNumber(dev, private_key, 32);
+    } while (!eccIsValidPrivateKey(private_key));
+    return storeKey(dev, key_id, private_key, key_type);
+}
+
+static bool computePublicKey(ATECC608 *dev, uint8_t key_id, uint8_t *public_key) {
+    uint8_t private_key[32];
+    if (key_id >= SLOT_COUNT) {
+        dev->lastError = 8;
+        return false;
+    }
+    SlotCache *cache = &dev->slotCache[key_id];
+    if (!cache->publicKeyValid) {
+        if (!read(dev, ZONE_DATA, slotAddress(dev, key_id), private_key, 32) ||
+            !eccComputePublicKey(private_key, cache->publicKey)) {
+            return false;
+        }
+        cache->publicKeyValid = true;
+    }
+    memcpy(public_key, cache->publicKey, 64);
+    return true;
+}
+
+// A stored public key is X || Y in blocks 0 and 1 of its slot, so the slot
+// needs at least 64 bytes
+static bool readPublicKey(ATECC608 *dev, uint8_t key_id, uint8_t *public_key) {
+    if (key_id >= 16) {
+        dev->lastError = 8;
+        return false;
+    }
+    if (slotSize(dev, key_id) < 64) {
+        dev->lastError = 3;
+        return false;
+    }
+    return read(dev, ZONE_DATA, slotAddress(dev, key_id), public_key, 32) &&
+           read(dev, ZONE_DATA, slotAddress(dev, key_id) + 32, public_key + 32, 32);
+}
+
+// Drops cached results for every slot overlapping the written data zone range
+static void invalidateSlotCache(ATECC608 *dev, uint16_t address, uint16_t len) {
+    const SlotLayout *slots = chipVariants[dev->variant].slots;
+    for (int slot = 0; slot < SLOT_COUNT; slot++) {
+        if (slots[slot].offset >= address + len || slots[slot].offset + slots[slot].size <= address) {
+            continue;
+        }
+        dev->slotCache[slot].publicKeyValid = false;
+        dev->slotCache[slot].verifyTableValid = false;
+        dev->slotCache[slot].aesKeyValid = 0;
+        dev->slotCache[slot].bootImageValid = false;
+        dev->infoStaleKeys |= 1 << slot;
+    }
+}
+
+// AES with key_id = slot or 0xFFFF for TempKey and mode bits 7-6 picking the
+// 16-byte key block. Encrypt and decrypt take one 16-byte block; GFM takes
+// H || X and returns the GCM product. Slot schedules come from the cache.
+static void cmdAes(ATECC608 *dev, uint8_t mode, uint16_t key_id, const uint8_t *data, uint8_t len) {
+    uint8_t *out = dev->responsePacket + 1;
+    uint8_t op = mode & AES_MODE_OP_MASK;
+    uint8_t block = mode >> AES_MODE_KEY_BLOCK_SHIFT;
+    if (op == AES_MODE_GFM) {
+        if (len != 32) {
+            setStatus(dev, STATUS_PARSE_ERROR);
+            return;
+        }
+        gfmMultiply(data, data + 16, out);
+        finishResponse(dev, 16);
+        return;
+    }
+    if ((op != AES_MODE_ENCRYPT && op != AES_MODE_DECRYPT) || len != 16) {
+        setStatus(dev, STATUS_PARSE_ERROR);
+        return;
+    }
+
+    Aes128Key tempkey_schedule;
+    const Aes128Key *key;
+    if (key_id == AES_KEY_ID_TEMPKEY) {
+        if (!dev->tempKey.valid) {
+            setStatus(dev, STATUS_EXECUTION_ERROR);
+            return;
+        }
+        aes128ExpandKey(&tempkey_schedule, dev->tempKey.value + 16 * block);
+        key = &tempkey_schedule;
+    } else {
+        key = key_id < SLOT_COUNT ? slotAesKey(dev, key_id, block) : NULL;
+    }
+    if (!key) {
+        setStatus(dev, STATUS_EXECUTION_ERROR);
+        return;
+    }
+    if (op == AES_MODE_ENCRYPT) {
+        aes128Encrypt(key, data, out);
+    } else {
+        aes128Decrypt(key, data, out);
+    }
+    finishResponse(dev, 16);
+}
+
+// Expanded schedule for one 16-byte key block of a slot, built on first use
+// and kept until the slot is written. NULL when the slot is too short.
+static const Aes128Key *slotAesKey(ATECC608 *dev, uint8_t slot, uint8_t block) {
+    SlotCache *cache = &dev->slotCache[slot];
+    if (16 * (block + 1) > slotSize(dev, slot)) {
+        return NULL;
+    }
+    if (!cache->aesKeys) {
+        cache->aesKeys = malloc(sizeof(Aes128Key) * AES_KEY_BLOCKS);
+        if (!cache->aesKeys) {
+            return NULL;
+        }
+    }
+    if (!(cache->aesKeyValid & (1 << block))) {
+        aes128ExpandKey(&cache->aesKeys[block], dev->slotData[slot] + 16 * block);
+        cache->aesKeyValid |= 1 << block;
+    }
+    return &cache->aesKeys[block];
+}
+
+// Counter with counter_id 0 or 1: mode 0 reads, mode 1 increments and
+// returns the new value, as 4 little-endian bytes. A counter at its 21-bit
+// maximum cannot be incremented.
+static void cmdCounter(ATECC608 *dev, uint8_t mode, uint16_t counter_id, const uint8_t *data, uint8_t len) {
+    if (counter_id >= COUNTER_COUNT || (mode != COUNTER_MODE_READ && mode != COUNTER_MODE_INCREMENT)) {
+        setStatus(dev, STATUS_PARSE_ERROR);
+        return;
+    }
+    uint16_t offset = COUNTER_OFFSET + 8 * counter_id;
+    uint32_t value = loadLe32(dev->configZone + offset) & COUNTER_MAX;
+    if (mode == COUNTER_MODE_INCREMENT) {
+        uint8_t *config = value < COUNTER_MAX ? pageWritable(dev, PAGE_CONFIG) : NULL;
+        if (!config) {
+            setStatus(dev, STATUS_EXECUTION_ERROR);
+            return;
+        }
+        uint8_t *packed = config + offset;
+        value++;
+        storeLe32(packed, value);
+        storeLe32(packed + 4, loadLe32(packed + 4) + 1);
+        markDirty(dev, ZONE_CONFIG, offset, 8);
+    }
+    uint8_t *out = dev->responsePacket + 1;
+    storeLe32(out, value);
+    setResponse(dev, out, 4);
+}
+
+// SecureBoot with the mode, digest slot and public key slot from config
+// bytes 70-71. Full takes digest || signature and verifies it against the
+// public key slot; with a stored signature or digest it takes the digest
+// alone and checks it against what the digest slot holds. FullStore verifies
+// digest || signature and on success stores the digest or signature. The
+// encrypted digest and MAC options (mode bit 7) are not modelled.
+static void cmdSecureBoot(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len) {
+    uint8_t config_mode = dev->configZone[SECUREBOOT_CONFIG_OFFSET] & SECUREBOOT_CONFIG_MODE_MASK;
+    uint8_t digest_slot = dev->configZone[SECUREBOOT_CONFIG_OFFSET + 1] & 0x0F;
+    uint8_t key_slot = dev->configZone[SECUREBOOT_CONFIG_OFFSET + 1] >> 4;
+    uint8_t op = mode & SECUREBOOT_MODE_MASK;
+    bool full = len == 96;
+    if ((mode & ~SECUREBOOT_MODE_MASK) || (len != 32 && !full) ||
+        (op != SECUREBOOT_MODE_FULL && op != SECUREBOOT_MODE_FULL_STORE) ||
+        (op == SECUREBOOT_MODE_FULL_STORE && (!full || config_mode == SECUREBOOT_CONFIG_FULL_BOTH)) ||
+        (!full && config_mode == SECUREBOOT_CONFIG_FULL_BOTH)) {
+        setStatus(dev, STATUS_PARSE_ERROR);
+        return;
+    }
+    if (config_mode == SECUREBOOT_CONFIG_DISABLED ||
+        slotSize(dev, digest_slot) < (config_mode == SECUREBOOT_CONFIG_FULL_DIG ? 32 : 64)) {
+        setStatus(dev, STATUS_EXECUTION_ERROR);
+        return;
+    }
+
+    const uint8_t *stored = dev->slotData[digest_slot];
+    bool verified;
+    if (full) {
+        verified = verifyBootImage(dev, key_slot, data);
+    } else if (config_mode == SECUREBOOT_CONFIG_FULL_DIG) {
+        verified = memcmp(data, stored, 32) == 0;
+    } else {
+        uint8_t image[96];
+        memcpy(image, data, 32);
+        memcpy(image + 32, stored, 64);
+        verified = verifyBootImage(dev, key_slot, image);
+    }
+    if (verified && op == SECUREBOOT_MODE_FULL_STORE) {
+        bool stored_ok = config_mode == SECUREBOOT_CONFIG_FULL_DIG
+            ? write(dev, ZONE_DATA, slotAddress(dev, digest_slot), data, 32)
+            : write(dev, ZONE_DATA, slotAddress(dev, digest_slot), data + 32, 32) &&
+              write(dev, ZONE_DATA, slotAddress(dev, digest_slot) + 32, data + 64, 32);
+        if (!stored_ok) {
+            setStatus(dev, STATUS_EXECUTION_ERROR);
+            return;
+        }
+    }
+    setStatus(dev, verified ? STATUS_SUCCESS : STATUS_VERIFY_FAILED);
+}
+
+// Info: mode 0 Revision, 1 KeyValid for slot param2, 2 State, 3 GPIO, which
+// reads the output latch or with INFO_GPIO_SET_LATCH in param2 sets it.
+// Every answer is prebuilt, see refreshInfo().
+static void cmdInfo(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len) {
+    switch (mode) {
+        case INFO_MODE_REVISION:
+            sendFramed(dev, dev->infoRevision);
+            return;
+        case INFO_MODE_KEY_VALID:
+            if (param2 < SLOT_COUNT) {
+                sendFramed(dev, dev->infoKeyValid[param2]);
+                return;
+            }
+            break;
+        case INFO_MODE_STATE:
+            sendFramed(dev, dev->infoState);
+            return;
+        case INFO_MODE_GPIO:
+            if (param2 & ~(INFO_GPIO_SET_LATCH | 1)) {
+                break;
+            }
+            if ((param2 & INFO_GPIO_SET_LATCH) && dev->gpioLatch != (param2 & 1)) {
+                dev->gpioLatch = param2 & 1;
+                frameResponse(dev->infoGpio, (uint8_t[4]){ dev->gpioLatch }, 4);
+            }
+            sendFramed(dev, dev->infoGpio);
+            return;
+    }
+    setStatus(dev, STATUS_PARSE_ERROR);
+}
+
+// Brings the Info answers that can change between commands up to date:
+// State (TempKey flags in the low byte, TempKey.Valid in bit 15) when it
+// differs from the prebuilt one, and KeyValid for the slots in
+// infoStaleKeys. Cheap enough to run after every command.
+static void refreshInfo(ATECC608 *dev) {
+    const TempKey *t = &dev->tempKey;
+    uint8_t state[4] = {
+        (t->keyId & 0x0F) | t->sourceFlag << 4 | t->genDigData << 5 | t->genKeyData << 6 | t->noMacFlag << 7,
+        t->valid << 7,
+    };
+    if (!dev->infoState[0] || memcmp(dev->infoState + 1, state, 4) != 0) {
+        frameResponse(dev->infoState, state, 4);
+    }
+    for (uint16_t stale = dev->infoStaleKeys; stale; stale &= stale - 1) {
+        uint8_t slot = __builtin_ctz(stale);
+        uint16_t key_config = keyConfig(dev, slot);
+        uint8_t valid[4] = {
+            (key_config & KEY_CONFIG_PRIVATE) &&
+            (key_config & KEY_CONFIG_KEY_TYPE_MASK) == KEY_CONFIG_KEY_TYPE_P256 &&
+            slotSize(dev, slot) >= 32 && eccIsValidPrivateKey(dev->slotData[slot]),
+        };
+        frameResponse(dev->infoKeyValid[slot], valid, 4);
+    }
+    dev->infoStaleKeys = 0;
+}
+
+// Rebuilds every Info answer, after a reset or a restore
+static void resetInfo(ATECC608 *dev) {
+    frameResponse(dev->infoRevision, chipVariants[dev->variant].revision, 4);
+    frameResponse(dev->infoGpio, (uint8_t[4]){ dev->gpioLatch }, 4);
+    dev->infoState[0] = 0;
+    dev->infoStaleKeys = 0xFFFF;
+    refreshInfo(dev);
+}
+
+// SelfTest: mode selects the tests, the answer has a bit set for each one
+// that failed. The results come from runSelfTests().
+static void cmdSelfTest(ATECC608 *dev, uint8_t mode, uint16_t param2, const uint8_t *data, uint8_t len) {
+    if (!mode || (mode & ~SELFTEST_MODE_ALL) || param2) {
+        setStatus(dev, STATUS_PARSE_ERROR);
+        return;
+    }
+    sendFramed(dev, selfTestResponses[mode]);
+}
+
+// Known-answer and consistency checks of the engines the chip runs on,
+// done once and framed into a SelfTest answer for every valid mode
+static void runSelfTests(void) {
+    static const uint8_t sha_abc[32] = {
+        0xBA, 0x78, 0x16, 0xBF, 0x8F, 0x01, 0xCF, 0xEA, 0x41, 0x41, 0x40, 0xDE, 0x5D, 0xAE, 0x22, 0x23,
+        0xB0, 0x03, 0x61, 0xA3, 0x96, 0x17, 0x7A, 0x9C, 0xB4, 0x10, 0xFF, 0x61, 0xF2, 0x00, 0x15, 0xAD,
+    };
+    static const uint8_t aes_key[16] = {  // FIPS-197 appendix C.1
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F,
+    };
+    static const uint8_t aes_plain[16] = {
+        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+    };
+    static const uint8_t aes_cipher[16] = {
+        0x69, 0xC4, 0xE0, 0xD8, 0x6A, 0x7B, 0x04, 0x30, 0xD8, 0xCD, 0xB7, 0x80, 0x70, 0xB4, 0xC5, 0x5A,
+    };
+    uint8_t failed = 0;
+    uint8_t out[64];
+
+    uint64_t rng[4];
+    uint64_t draws[8];
+    seedRandom(rng, 1);
+    for (int i = 0; i < 8; i++) {
+        draws[i] = nextRandom(rng);
+    }
+    if (memcmp(draws, draws + 4, sizeof(draws) / 2) == 0) {
+        failed |= SELFTEST_MODE_RNG;
+    }
+
+    sha256((const uint8_t *)"abc", 3, out);
+    if (memcmp(out, sha_abc, 32) != 0) {
+        failed |= SELFTEST_MODE_SHA;
+    }
+
+    Aes128Key key;
+    aes128ExpandKey(&key, aes_key);
+    aes128Encrypt(&key, aes_plain, out);
+    aes128Decrypt(&key, out, out + 16);
+    if (memcmp(out, aes_cipher, 16) != 0 || memcmp(out + 16, aes_plain, 16) != 0) {
+        failed |= SELFTEST_MODE_AES;
+    }
+
+    // Two key pairs from the SHA answer: sign and verify with one, and
+    // both sides of an ECDH exchange have to agree
+    uint8_t private_a[32], private_b[32], public_a[64], public_b[64];
+    uint8_t signature[64], secret_a[32], secret_b[32], tampered[32];
+    memcpy(private_a, sha_abc, 32);
+    memcpy(tampered, sha_abc, 32);
+    tampered[31] ^= 1;
+    sha256(private_a, 32, private_b);
+    if (!eccComputePublicKey(private_a, public_a) || !eccComputePublicKey(private_b, public_b) ||
+        !eccSign(private_a, sha_abc, private_b, signature) ||
+        !verifySignature(sha_abc, signature, public_a) || verifySignature(tampered, signature, public_a)) {
+        failed |= SELFTEST_MODE_ECDSA;
+    }
+    if (!eccSharedSecret(private_a, public_b, secret_a) || !eccSharedSecret(private_b, public_a, secret_b) ||
+        memcmp(secret_a, secret_b, 32) != 0) {
+        failed |= SELFTEST_MODE_ECDH;
+    }
+
+    for (uint8_t mode = 1; mode <= SELFTEST_MODE_ALL; mode++) {
+        uint8_t result = failed & mode;
+        frameResponse(selfTestResponses[mode], &result, 1);
+    }
+    selfTestReady = true;
+}
+
+// IO protection for ECDH and KDF output: each 32-byte block of out is XORed
+// with SHA-256(IO key || 16 nonce bytes), and the 32-byte output nonce is
+// appended after the len bytes. The IO key slot is ChipOptions[15:12].
+static bool encryptOutput(ATECC608 *dev, uint8_t *out, uint8_t len) {
+    uint8_t io_key_slot = dev->configZone[91] >> 4;
+    uint8_t *nonce = out + len;
+    uint8_t block[48];
+    uint8_t pad[32];
+    if (!read(dev, ZONE_DATA, slotAddress(dev, io_key_slot), block, 32)) {
+        return false;
+    }
+    generateRandomNumber(dev, nonce, 32);
+    for (uint8_t offset = 0; offset < len; offset += 32) {
+        memcpy(block + 32, nonce + (offset / 32) * 16, 16);
+        sha256(block, sizeof(block), pad);
+        for (uint8_t i = offset; i < len && i < offset + 32; i++) {
+            out[i] ^= pad[i - offset];
+        }
+    }
+    return true;
+}
+
+// Keeps the chip busy for duration ms of simulated time. Like the real part,
+// it does not acknowledge its address until execution has finished, so
+// firmware has to go through its polling or fixed-delay path. The delay is
+// set in nanoseconds so any latency override fits.
+static void simulateExecutionTime(ATECC608 *dev, uint32_t duration) {
+    dev->executionTime = duration;
+    if (duration > 0) {
+        dev->busy = true;
+        timer_start_ns(dev->timer, (uint64_t)duration * 1000000, false);
+    }
+}
+
+static void setLatencyProfile(ATECC608 *dev, uint32_t profile) {
+    for (size_t i = 0; i < LATENCY_ENTRIES; i++) {
+        switch (profile) {
+            case LATENCY_MAX: dev->latency[i] = latencyTable[i].max; break;
+            case LATENCY_ZERO: dev->latency[i] = 0; break;
+            default: dev->latency[i] = latencyTable[i].typical; break;
+        }
+    }
+}
+
+// Applies the "latencyProfile" attribute, then any per-opcode overrides
+static void loadLatencyAttributes(ATECC608 *dev) {
+    setLatencyProfile(dev, attr_read(attr_init("latencyProfile", LATENCY_TYPICAL)));
+    for (size_t i = 0; i < LATENCY_ENTRIES; i++) {
+        uint32_t override = attr_read(attr_init(latencyTable[i].attr, LATENCY_DEFAULT));
+        if (override != LATENCY_DEFAULT) {
+            dev->latency[i] = override;
+        }
+    }
+}
+
+static uint32_t commandLatency(ATECC608 *dev, uint8_t opcode) {
+    return commandTable[opcode].handler ? dev->latency[commandTable[opcode].latency] : 0;
+}
+
+static uint64_t hostNanos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void recordCommand(ATECC608 *dev, uint8_t slot, uint64_t start) {
+    uint64_t elapsed = hostNanos() - start;
+    CommandStats *stats = &dev->stats.command[slot];
+    stats->calls++;
+    if (dev->responsePacket[0] == 4 && dev->responsePacket[1] != STATUS_SUCCESS) {
+        stats->errors++;
+    }
+    stats->busyMs += dev->executionTime;
+    stats->hostNs += elapsed;
+    int bucket = elapsed ? 63 - __builtin_clzll(elapsed) : 0;
+    stats->histogram[bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1]++;
+}
+
+// Prints the counters of every command that ran at least once. Histogram
+// entries read "2^k:n": n calls took between 2^k and 2^(k+1) ns on the host.
+void atecc608_dump_stats(ATECC608 *dev) {
+    const DeviceStats *s = &dev->stats;
+    printf("ATECC608 stats (%s): %u connects, %u busy NACKs, %u sleep NACKs, %u wakes, "
+           "%u watchdog sleeps, %u CRC errors, %u rejected, %llu bytes in, %llu bytes out\n",
+           chipVariants[dev->variant].name, s->connects, s->busyNacks, s->sleepNacks, s->wakes, s->watchdogSleeps,
+           s->crcErrors, s->rejected,
+           (unsigned long long)s->bytesIn, (unsigned long long)s->bytesOut);
+    for (size_t i = 0; i < LATENCY_ENTRIES; i++) {
+        const CommandStats *c = &s->command[i];
+        if (!c->calls) {
+            continue;
+        }
+        printf("  %-10s calls %u errors %u busy %llu ms host %llu ns (avg %llu ns)",
+               latencyTable[i].name, c->calls, c->errors, (unsigned long long)c->busyMs,
+               (unsigned long long)c->hostNs, (unsigned long long)(c->hostNs / c->calls));
+        for (int b = 0; b < STATS_BUCKETS; b++) {
+            if (c->histogram[b]) {
+                printf(" 2^%d:%u", b, c->histogram[b]);
+            }
+        }
+        printf("\n");
+    }
+    if (s->command[LAT_SECUREBOOT].calls) {
+        printf("  SecureBoot cache hits %u\n", s->secureBootHits);
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        const uint8_t *packed = dev->configZone + COUNTER_OFFSET + 8 * i;
+        uint32_t increments = loadLe32(packed + 4);
+        uint32_t cycles = (increments + COUNTER_WEAR_CELLS - 1) / COUNTER_WEAR_CELLS;
+        printf("  Counter %d value %u increments %u wear %u/%u cycles (%.3f%%)\n", i,
+               loadLe32(packed) & COUNTER_MAX, increments, cycles, EEPROM_ENDURANCE,
+               100.0 * cycles / EEPROM_ENDURANCE);
+    }
+    unsigned own_bytes = 0;
+    for (uint8_t page = 0; page < PAGE_COUNT; page++) {
+        if (dev->ownPages & (1u << page)) {
+            own_bytes += pageSize(dev, page);
+        }
+    }
+    printf("  Zone pages %d of %d private, %u bytes\n",
+           __builtin_popcount(dev->ownPages), PAGE_COUNT, own_bytes);
+}
+
+static void on_execution_done(void *user_data) {
+    ATECC608 *dev = user_data;
+    dev->busy = false;
+}
+
+// Host entry points run commands immediately: they skip the wake pulse and
+// delay, and do not wait for a command still executing
+static void readyForHost(ATECC608 *dev) {
+    if (dev->busy) {
+        timer_stop(dev->timer);
+        dev->busy = false;
+    }
+    if (dev->state != ACTIVE || dev->waking) {
+        if (dev->waking) {
+            timer_stop(dev->wakeTimer);
+        }
+        on_wake_done(dev);
+    }
+}
+
+// Starts waking the chip, as a long enough low pulse on SDA does. It NACKs
+// for wakeDelay more microseconds and then answers with the wake status.
+void atecc608_wake(ATECC608 *dev) {
+    if (dev->state == ACTIVE || dev->waking) {
+        return;
+    }
+    if (!dev->wakeDelay) {
+        on_wake_done(dev);
+        return;
+    }
+    dev->waking = true;
+    timer_start(dev->wakeTimer, dev->wakeDelay, false);
+}
+
+static void on_wake_done(void *user_data) {
+    ATECC608 *dev = user_data;
+    dev->waking = false;
+    dev->state = ACTIVE;
+    dev->stats.wakes++;
+    setStatus(dev, STATUS_WAKE);
+    if (dev->watchdogTimeout) {
+        timer_start_ns(dev->watchdogTimer, (uint64_t)dev->watchdogTimeout * 1000000, false);
+        dev->watchdogArmed = true;
+    }
+    traceEvent(dev, TRACE_EVENT_WAKE);
+}
+
+static void on_watchdog(void *user_data) {
+    ATECC608 *dev = user_data;
+    dev->watchdogArmed = false;
+    dev->stats.watchdogSleeps++;
+    powerDown(dev, SLEEP);
+    traceEvent(dev, TRACE_EVENT_WATCHDOG);
+}
+
+// Sleep clears TempKey, the message digest and alternate key buffers and
+// the SHA context; idle keeps them. A command still running is cut short.
+static void powerDown(ATECC608 *dev, DeviceState state) {
+    stopPowerTimers(dev);
+    if (dev->busy) {
+        timer_stop(dev->timer);
+        dev->busy = false;
+    }
+    dev->state = state;
+    if (state == SLEEP) {
+        memset(&dev->tempKey, 0, sizeof(dev->tempKey));
+        memset(dev->msgDigBuf, 0, sizeof(dev->msgDigBuf));
+        memset(dev->altKeyBuf, 0, sizeof(dev->altKeyBuf));
+        dev->shaContext = SHA_CONTEXT_NONE;
+        refreshInfo(dev);
+    }
+}
+
+static void stopPowerTimers(ATECC608 *dev) {
+    if (dev->waking) {
+        timer_stop(dev->wakeTimer);
+        dev->waking = false;
+    }
+    if (dev->watchdogArmed) {
+        timer_stop(dev->watchdogTimer);
+        dev->watchdogArmed = false;
+    }
+}
+
+// Frames len payload bytes as count, payload, CRC. data may already point
+// into responsePacket + 1.
+static void setResponse(ATECC608 *dev, uint8_t *data, uint8_t len) {
+    memmove(dev->responsePacket + 1, data, len);
+    finishResponse(dev, len);
+}
+
+// Frames a payload that was written straight to responsePacket + 1
+static void finishResponse(ATECC608 *dev, uint8_t len) {
+    dev->responsePacket[0] = len + 3;
+    uint16_t crc = calculateCRC(dev->responsePacket, len + 1);
+    dev->responsePacket[len + 1] = crc & 0xFF;
+    dev->responsePacket[len + 2] = crc >> 8;
+    dev->responsePos = 0;
+}
+
+static void setStatus(ATECC608 *dev, uint8_t status) {
+    setResponse(dev, &status, 1);
+}
+
+// Frames len payload bytes into packet ahead of time, for sendFramed()
+static void frameResponse(uint8_t *packet, const uint8_t *payload, uint8_t len) {
+    packet[0] = len + 3;
+    memcpy(packet + 1, payload, len);
+    uint16_t crc = calculateCRC(packet, len + 1);
+    packet[len + 1] = crc & 0xFF;
+    packet[len + 2] = crc >> 8;
+}
+
+static void sendFramed(ATECC608 *dev, const uint8_t *packet) {
+    memcpy(dev->responsePacket, packet, packet[0]);
+    dev->responsePos = 0;
+}
+
+// Runs one bus packet (word address first) to completion without waiting
+// for simulated time, and copies out the response. Returns the response
+// length, or 0 if there is none or it does not fit in max.
+size_t atecc608_execute(ATECC608 *dev, const uint8_t *packet, size_t len, uint8_t *response, size_t max) {
+    readyForHost(dev);
+    dev->busState = BUS_WORD_ADDRESS;
+    dev->responsePacket[0] = 0;
+    atecc608_write(dev, packet, len);
+    if (dev->busy) {
+        timer_stop(dev->timer);
+        dev->busy = false;
+    }
+    size_t response_len = dev->responsePacket[0];
+    if (response_len == 0 || response_len > MAX_PACKET_SIZE || response_len > max) {
+        return 0;
+    }
+    memcpy(response, dev->responsePacket, response_len);
+    return response_len;
+}
+
+// Runs commands back to back straight through the dispatch table, with no
+// I2C framing, CRCs or simulated execution time. Each response (count,
+// payload, CRC) is appended to out, and *out_len receives the bytes used.
+// Returns how many commands ran, which falls short of count only once out
+// has less than MAX_PACKET_SIZE bytes left.
+size_t atecc608_batch(ATECC608 *dev, const BatchCommand *commands, size_t count, uint8_t *out, size_t max, size_t *out_len) {
+    size_t used = 0;
+    size_t i;
+    readyForHost(dev);
+    for (i = 0; i < count && max - used >= MAX_PACKET_SIZE; i++) {
+        const BatchCommand *c = &commands[i];
+        if (!sendCommand(dev, c->opcode, c->param1, c->param2, c->data, c->dataLen)) {
+            setStatus(dev, STATUS_PARSE_ERROR);
+        }
+        if (dev->busy) {
+            timer_stop(dev->timer);
+            dev->busy = false;
+        }
+        uint8_t response_len = dev->responsePacket[0];
+        memcpy(out + used, dev->responsePacket, response_len);
+        used += response_len;
+    }
+    if (out_len) {
+        *out_len = used;
+    }
+    return i;
+}
+
+void atecc608_reset(ATECC608 *dev) {
+    atecc608_init(dev);
+}
+
+size_t atecc608_snapshot_size(void) {
+    return SNAPSHOT_SIZE;
+}
+
+// Writes the device state to buf and returns the snapshot length, or 0 if
+// buf is too small
+size_t atecc608_snapshot(ATECC608 *dev, uint8_t *buf, size_t len) {
+    if (len < atecc608_snapshot_size()) {
+        return 0;
+    }
+    const SnapshotHeader header = {
+        .magic = SNAPSHOT_MAGIC,
+        .version = SNAPSHOT_VERSION,
+        .size = SNAPSHOT_STATE_SIZE,
+    };
+    memcpy(buf, &header, sizeof(header));
+    memcpy(buf + sizeof(header), dev, SNAPSHOT_STATE_SIZE);
+    imageRead(dev, 0, buf + sizeof(header) + SNAPSHOT_STATE_SIZE, EEPROM_SIZE);
+    return atecc608_snapshot_size();
+}
+
+// A bool field restored from a snapshot, read as the byte it was stored as
+static bool snapshotBool(const bool *field) {
+    uint8_t byte;
+    memcpy(&byte, field, 1);
+    return byte <= 1;
+}
+
+// Range-checks the fields a restored snapshot sets that the command code
+// uses as indexes or lengths, or relies on to be 0 or 1
+static bool snapshotStateValid(const ATECC608 *dev) {
+    const TempKey *tempKey = &dev->tempKey;
+    return dev->state <= ACTIVE && dev->shaContext <= SHA_CONTEXT_HMAC &&
+           dev->sha.inner.blockLen < 64 && dev->sha.outer.blockLen < 64 &&
+           tempKey->keyId < SLOT_COUNT && snapshotBool(&tempKey->sourceFlag) &&
+           snapshotBool(&tempKey->genDigData) && snapshotBool(&tempKey->genKeyData) &&
+           snapshotBool(&tempKey->noMacFlag) && snapshotBool(&tempKey->valid) &&
+           snapshotBool(&dev->gpioLatch);
+}
+
+// Replaces the device state with a snapshot. Like a power cycle, the bus
+// side starts over: any running command is dropped and derived caches are
+// rebuilt on demand. Zone pages that match the golden image are shared
+// again. A backing EEPROM image is rewritten to match. If a field is out of
+// range or the zones cannot be allocated the device is reset instead and
+// false is returned.
+bool atecc608_restore(ATECC608 *dev, const uint8_t *buf, size_t len) {
+    SnapshotHeader header;
+    if (len != atecc608_snapshot_size()) {
+        return false;
+    }
+    memcpy(&header, buf, sizeof(header));
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+        header.size != SNAPSHOT_STATE_SIZE ||
+        buf[sizeof(header) + offsetof(ATECC608, variant)] >= VARIANT_COUNT) {
+        return false;
+    }
+    uint8_t variant = dev->variant;
+    stopPowerTimers(dev);
+    memcpy(dev, buf + sizeof(header), SNAPSHOT_STATE_SIZE);
+    if (!snapshotStateValid(dev)) {
+        atecc608_init(dev);
+        return false;
+    }
+    if (dev->variant != variant) {
+        sharePages(dev);  // Slot pages are sized for the old layout
+    }
+    if (!loadImage(dev, buf + sizeof(header) + SNAPSHOT_STATE_SIZE)) {
+        atecc608_init(dev);
+        return false;
+    }
+    if (dev->state == ACTIVE && dev->watchdogTimeout) {
+        timer_start_ns(dev->watchdogTimer, (uint64_t)dev->watchdogTimeout * 1000000, false);
+        dev->watchdogArmed = true;
+    }
+
+    if (dev->busy) {
+        timer_stop(dev->timer);
+        dev->busy = false;
+    }
+    dev->busState = BUS_WORD_ADDRESS;
+    dev->packetPos = 0;
+    dev->responsePos = 0;
+    dev->shaStreaming = false;
+    invalidateSlotCache(dev, 0, DATA_SIZE);
+    resetInfo(dev);
+    dev->eepromDirty = (1ull << eepromBlocks(dev->variant)) - 1;
+    eepromFlush(dev);
+    return true;
+}
+
+// When the ATECC608_TRACE_DIR environment variable is set, every packet the
+// chip completes and every power state change is logged to <dir>/atecc608-<address>.trace, starting from
+// a snapshot of the device so tools/atecc608-replay can reproduce the run.
+// Records collect in a preallocated buffer that is written out when full,
+// through atecc608_flush_trace(), or when the dumpStats control changes.
+static void traceOpen(ATECC608 *dev) {
+    const char *dir = getenv("ATECC608_TRACE_DIR");
+    if (!dir || !*dir) {
+        return;
+    }
+    char path[512];
+    snprintf(path, sizeof(path), "%s/atecc608-%02x.trace", dir, dev->address);
+    dev->traceBuffer = malloc(TRACE_BUFFER_SIZE);
+    dev->trace = dev->traceBuffer ? fopen(path, "wb") : NULL;
+    if (!dev->trace) {
+        printf("ATECC608: cannot open trace %s\n", path);
+        free(dev->traceBuffer);
+        dev->traceBuffer = NULL;
+        return;
+    }
+
+    size_t snapshot_len = atecc608_snapshot_size();
+    uint8_t *header = dev->traceBuffer;
+    storeLe32(header, TRACE_MAGIC);
+    storeLe32(header + 6, snapshot_len);
+    header[4] = TRACE_VERSION & 0xFF;
+    header[5] = TRACE_VERSION >> 8;
+    dev->traceLen = 10 + atecc608_snapshot(dev, header + 10, TRACE_BUFFER_SIZE - 10);
+}
+
+void atecc608_flush_trace(ATECC608 *dev) {
+    if (!dev->trace || !dev->traceLen) {
+        return;
+    }
+    fwrite(dev->traceBuffer, 1, dev->traceLen, dev->trace);
+    fflush(dev->trace);
+    dev->traceLen = 0;
+}
+
+static void traceRecord(ATECC608 *dev, uint8_t count) {
+    uint8_t response_len = dev->responsePacket[0];
+    if (response_len > MAX_PACKET_SIZE) {
+        response_len = 0;
+    }
+    size_t needed = 8 + count + 1 + (response_len ? response_len - 1 : 0);
+    if (dev->traceLen + needed > TRACE_BUFFER_SIZE) {
+        atecc608_flush_trace(dev);
+    }
+
+    uint8_t *out = dev->traceBuffer + dev->traceLen;
+    uint64_t now = get_sim_nanos();
+    for (int i = 0; i < 8; i++) {
+        out[i] = now >> (8 * i);
+    }
+    memcpy(out + 8, dev->tracePacket + 1, count);
+    if (response_len) {
+        memcpy(out + 8 + count, dev->responsePacket, response_len);
+    } else {
+        out[8 + count] = 0;
+    }
+    dev->traceLen += needed;
+}
+
+// Records a power event, one of TRACE_EVENT_*, as a record with count 0
+static void traceEvent(ATECC608 *dev, uint8_t event) {
+    if (!dev->trace) {
+        return;
+    }
+    if (dev->traceLen + 10 > TRACE_BUFFER_SIZE) {
+        atecc608_flush_trace(dev);
+    }
+    uint8_t *out = dev->traceBuffer + dev->traceLen;
+    uint64_t now = get_sim_nanos();
+    for (int i = 0; i < 8; i++) {
+        out[i] = now >> (8 * i);
+    }
+    out[8] = 0;
+    out[9] = event;
+    dev->traceLen += 10;
+}
+
+// Dumps the stats and flushes the trace whenever the "dumpStats" control
+// changes value
+static void checkStatsDump(ATECC608 *dev) {
+    uint32_t value = attr_read(dev->statsDumpAttr);
+    if (value != dev->statsDumpValue) {
+        dev->statsDumpValue = value;
+        atecc608_dump_stats(dev);
+        atecc608_flush_trace(dev);
+    }
+}
+
+// Wokwi API integration
+static bool on_i2c_connect(void *user_data, uint32_t address, bool read) {
+    ATECC608 *dev = user_data;
+    checkStatsDump(dev);
+    dev->stats.connects++;
+    if (dev->state != ACTIVE || dev->waking) {
+        dev->stats.sleepNacks++;
+        return false;
+    }
+    if (dev->busy) {
+        dev->stats.busyNacks++;
+        return false;
+    }
+    if (!read) {
+        dev->busState = BUS_WORD_ADDRESS;  // A write always starts with the word address
+    }
+    return true;
+}
+
+static uint8_t on_i2c_read(void *user_data) {
+    ATECC608 *dev = user_data;
+    return atecc608_read_byte(dev);
+}
+
+static bool on_i2c_write(void *user_data, uint8_t data) {
+    ATECC608 *dev = user_data;
+    atecc608_write_byte(dev, data);
+    return true;
+}
+
+// A stop ends the transaction; a packet cut short by it is dropped
+static void on_i2c_disconnect(void *user_data) {
+    ATECC608 *dev = user_data;
+    dev->busState = BUS_WORD_ADDRESS;
+    dev->shaStreaming = false;
+}
+
+// Times how long SDA stays low to spot wake pulses. An ordinary 0x00 byte
+// at 100 kHz is long enough, which is how most drivers wake the chip.
+static void on_sda_change(void *user_data, pin_t pin, uint32_t value) {
+    ATECC608 *dev = user_data;
+    uint64_t now = get_sim_nanos();
+    if (value == LOW) {
+        dev->sdaLow = true;
+        dev->sdaLowSince = now;
+    } else if (dev->sdaLow) {
+        dev->sdaLow = false;
+        if (now - dev->sdaLowSince >= WAKE_LOW_NS) {
+            atecc608_wake(dev);
+        }
+    }
+}
+
+// Creates a device from the chip attributes, without attaching it to a bus.
+// chip_init() uses it for the simulator; host tools call it directly.
+ATECC608 *atecc608_create(void) {
+    ATECC608 *dev = calloc(1, sizeof(ATECC608));
+    if (!dev) {
+        return NULL;
+    }
+    dev->variant = attr_read(attr_init("variant", ATECC608_VARIANT));
+    if (dev->variant >= VARIANT_COUNT) {
+        printf("ATECC608: unknown variant %u, using %s\n", dev->variant, chipVariants[ATECC608_VARIANT].name);
+        dev->variant = ATECC608_VARIANT;
+    }
+    dev->address = attr_read(attr_init("i2cAddress", chipVariants[dev->variant].i2cAddress >> 1));
+    dev->seed = attr_read(attr_init("seed", 0));
+    dev->statsDumpAttr = attr_init("dumpStats", 0);
+    dev->statsDumpValue = attr_read(dev->statsDumpAttr);
+    dev->wakeDelay = attr_read(attr_init("wakeDelay", WAKE_DELAY_DEFAULT));
+    dev->watchdogTimeout = attr_read(attr_init("watchdogTimeout", WATCHDOG_TIMEOUT_DEFAULT));
+    eepromOpen(dev, dev->address);
+    atecc608_init(dev);
+    loadLatencyAttributes(dev);
+
+    const timer_config_t timer_config = {
+        .user_data = dev,
+        .callback = on_execution_done,
+    };
+    dev->timer = timer_init(&timer_config);
+    const timer_config_t wake_config = {
+        .user_data = dev,
+        .callback = on_wake_done,
+    };
+    dev->wakeTimer = timer_init(&wake_config);
+    const timer_config_t watchdog_config = {
+        .user_data = dev,
+        .callback = on_watchdog,
+    };
+    dev->watchdogTimer = timer_init(&watchdog_config);
+    traceOpen(dev);
+    return dev;
+}
+
+// Each call creates an independent chip; all state hangs off the instance
+// passed through user_data, so several devices can share one bus or process.
+void chip_init() {
+    ATECC608 *dev = atecc608_create();
+    if (!dev) {
+        return;
+    }
+    pin_t sda = pin_init("SDA", INPUT);
+    const pin_watch_config_t sda_watch = {
+        .user_data = dev,
+        .edge = BOTH,
+        .pin_change = on_sda_change,
+    };
+    pin_watch(sda, &sda_watch);
+
+    const i2c_config_t i2c_config = {
+        .user_data = dev,
+        .address = dev->address,
+        .scl = pin_init("SCL", INPUT),
+        .sda = sda,
+        .connect = on_i2c_connect,
+        .read = on_i2c_read,
+        .write = on_i2c_write,
+        .disconnect = on_i2c_disconnect,
+    };
+    i2c_init(&i2c_config);
 }
\ No newline at end of file
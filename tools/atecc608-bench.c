@@ -0,0 +1,181 @@
+// Host CPU benchmark for the ATECC608 chip. Drives the I2C callbacks the
+// chip registers, byte by byte as Wokwi would, through a fixed mix of
+// commands and reports the host cost of each opcode.
+//
+// Build from the repository root, natively:
+//   cc -O2 -Itools tools/atecc608-bench.c tools/wokwi-host.c -o atecc608-bench
+// or for WebAssembly with wasi-sdk (the portable crypto paths are used):
+//   clang --target=wasm32-wasi -O2 -DATECC608_PORTABLE_CRYPTO -Itools
+//       tools/atecc608-bench.c tools/wokwi-host.c -o atecc608-bench.wasm
+// Run:
+//   ./atecc608-bench [rounds]        (default 200)
+//   wasmtime atecc608-bench.wasm [rounds]
+//
+// Each round wakes the chip, issues Random, Nonce + Sign, Nonce + Verify of
+// a fixed signature, an SHA Start/Update/End stream over 1000 bytes and a
+// Read of every config block, then puts it to sleep. Completion is polled
+// every BENCH_POLL_NS of simulated time; the figures are host time only,
+// including the bus front end and the polls.
+#include "../chip-atecc608/atecc608.c"
+
+#define BENCH_SHA_BYTES 1000  // Five 192-byte Updates and a 40-byte End
+#define BENCH_POLL_NS 100000
+
+typedef struct {
+    uint64_t calls;
+    uint64_t failures;
+    uint64_t ns;
+    uint64_t bytes;  // Bus bytes in both directions
+} BenchStats;
+
+static const i2c_config_t *bus;
+static BenchStats benchStats[256];
+static BenchStats wakeStats;
+
+// Polls the address until the chip ACKs, then clocks out the response
+static void readResponse(uint8_t *response) {
+    while (!bus->connect(bus->user_data, bus->address, true)) {
+        host_advance(BENCH_POLL_NS);
+    }
+    response[0] = bus->read(bus->user_data);
+    for (int i = 1; i < response[0] && i < MAX_PACKET_SIZE; i++) {
+        response[i] = bus->read(bus->user_data);
+    }
+    bus->disconnect(bus->user_data);
+}
+
+static void wakeChip(void) {
+    uint8_t response[MAX_PACKET_SIZE];
+    uint64_t start = hostNanos();
+    atecc608_wake(bus->user_data);
+    readResponse(response);
+    wakeStats.ns += hostNanos() - start;
+    wakeStats.calls++;
+    wakeStats.bytes += response[0];
+    if (response[0] != 4 || response[1] != STATUS_WAKE) {
+        wakeStats.failures++;
+    }
+}
+
+static void sleepChip(void) {
+    bus->connect(bus->user_data, bus->address, false);
+    bus->write(bus->user_data, CMD_SLEEP);
+    bus->disconnect(bus->user_data);
+}
+
+// Sends one command and reads back the response, as a host driver would
+static uint8_t transact(uint8_t opcode, uint8_t p1, uint16_t p2, const uint8_t *data, uint8_t len, uint8_t *response) {
+    uint8_t packet[256];
+    uint8_t count = len + 7;
+    packet[0] = 0x03;
+    packet[1] = count;
+    packet[2] = opcode;
+    packet[3] = p1;
+    packet[4] = p2 & 0xFF;
+    packet[5] = p2 >> 8;
+    memcpy(packet + 6, data, len);
+    uint16_t crc = calculateCRC(packet + 1, count - 2);
+    packet[count - 1] = crc & 0xFF;
+    packet[count] = crc >> 8;
+
+    uint64_t start = hostNanos();
+    bus->connect(bus->user_data, bus->address, false);
+    for (int i = 0; i <= count; i++) {
+        bus->write(bus->user_data, packet[i]);
+    }
+    bus->disconnect(bus->user_data);
+    readResponse(response);
+
+    BenchStats *stats = &benchStats[opcode];
+    stats->ns += hostNanos() - start;
+    stats->calls++;
+    stats->bytes += count + 1 + response[0];
+    if (response[0] == 4 && response[1] != STATUS_SUCCESS) {
+        stats->failures++;
+    }
+    return response[0];
+}
+
+static void printStats(const char *name, const BenchStats *stats) {
+    if (!stats->calls) {
+        return;
+    }
+    printf("%-8s %8llu %12.0f %14.0f %8llu\n", name,
+           (unsigned long long)stats->calls,
+           (double)stats->ns / stats->calls,
+           stats->ns ? stats->bytes * 1e9 / stats->ns : 0.0,
+           (unsigned long long)stats->failures);
+}
+
+int main(int argc, char **argv) {
+    int rounds = argc > 1 ? atoi(argv[1]) : 200;
+    if (rounds < 1) {
+        rounds = 1;
+    }
+
+    unsetenv("ATECC608_EEPROM_DIR");
+    unsetenv("ATECC608_TRACE_DIR");
+    chip_init();
+    bus = host_i2c_device(0);
+    if (!bus) {
+        fprintf(stderr, "chip did not register on the bus\n");
+        return 1;
+    }
+
+    // Setup: a key pair in slot 2 and one signature over a fixed digest
+    uint8_t response[MAX_PACKET_SIZE];
+    uint8_t digest[32];
+    uint8_t verify[128];
+    for (int i = 0; i < 32; i++) {
+        digest[i] = i;
+    }
+    wakeChip();
+    transact(CMD_GENKEY, 0x04, 2, NULL, 0, response);
+    memcpy(verify + 64, response + 1, 64);
+    transact(CMD_NONCE, NONCE_MODE_PASSTHROUGH, 0, digest, 32, response);
+    transact(CMD_SIGN, 0x80, 2, NULL, 0, response);
+    memcpy(verify, response + 1, 64);
+    sleepChip();
+
+    uint8_t message[BENCH_SHA_BYTES];
+    for (int i = 0; i < BENCH_SHA_BYTES; i++) {
+        message[i] = i * 7;
+    }
+    memset(benchStats, 0, sizeof(benchStats));
+    memset(&wakeStats, 0, sizeof(wakeStats));
+
+    uint64_t start = hostNanos();
+    for (int round = 0; round < rounds; round++) {
+        wakeChip();
+        transact(CMD_RANDOM, 0, 0, NULL, 0, response);
+
+        transact(CMD_NONCE, NONCE_MODE_PASSTHROUGH, 0, digest, 32, response);
+        transact(CMD_SIGN, 0x80, 2, NULL, 0, response);
+
+        transact(CMD_NONCE, NONCE_MODE_PASSTHROUGH, 0, digest, 32, response);
+        transact(CMD_VERIFY, 0x02, 0x0004, verify, 128, response);
+
+        transact(CMD_SHA, SHA_MODE_START, 0, NULL, 0, response);
+        for (int offset = 0; offset + 192 <= BENCH_SHA_BYTES; offset += 192) {
+            transact(CMD_SHA, SHA_MODE_UPDATE, 0, message + offset, 192, response);
+        }
+        transact(CMD_SHA, SHA_MODE_END, 0, message, BENCH_SHA_BYTES % 192, response);
+
+        for (int block = 0; block < CONFIG_SIZE / 32; block++) {
+            transact(CMD_READ, ZONE_CONFIG | ZONE_MODE_32_BYTES, block << 3, NULL, 0, response);
+        }
+        sleepChip();
+    }
+    uint64_t elapsed = hostNanos() - start;
+
+    printf("%-8s %8s %12s %14s %8s\n", "opcode", "calls", "ns/command", "bytes/s", "failed");
+    printStats("Wake", &wakeStats);
+    printStats("Random", &benchStats[CMD_RANDOM]);
+    printStats("Nonce", &benchStats[CMD_NONCE]);
+    printStats("Sign", &benchStats[CMD_SIGN]);
+    printStats("Verify", &benchStats[CMD_VERIFY]);
+    printStats("SHA", &benchStats[CMD_SHA]);
+    printStats("Read", &benchStats[CMD_READ]);
+    printf("%d rounds in %.3f ms, %.1f us/round\n", rounds, elapsed / 1e6, elapsed / 1e3 / rounds);
+    return 0;
+}
@@ -0,0 +1,267 @@
+// Session-level checks for the ATECC608 chip: sequences whose outcome
+// depends on more than one command, driven through the I2C callbacks as
+// Wokwi would. Prints one line per check and exits non-zero if any fails.
+//
+// Build from the repository root:
+//   cc -O1 -Itools tools/atecc608-check.c tools/wokwi-host.c -o atecc608-check
+// Run:
+//   ./atecc608-check
+//
+// The trace check records a session with power transitions between
+// dependent commands into a scratch directory and replays it through
+// tools/atecc608-replay.c, which must reproduce every response.
+#define ATECC608_REPLAY_NO_MAIN
+#include "atecc608-replay.c"
+
+#define CHECK_POLL_NS 100000
+
+static const i2c_config_t *bus;
+static int failures;
+
+static void check(bool ok, const char *what) {
+    printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+// Polls the address until the chip ACKs, then clocks out the response
+static void readResponse(uint8_t *response) {
+    while (!bus->connect(bus->user_data, bus->address, true)) {
+        host_advance(CHECK_POLL_NS);
+    }
+    response[0] = bus->read(bus->user_data);
+    for (int i = 1; i < response[0] && i < MAX_PACKET_SIZE; i++) {
+        response[i] = bus->read(bus->user_data);
+    }
+    bus->disconnect(bus->user_data);
+}
+
+static void wakeChip(void) {
+    uint8_t response[MAX_PACKET_SIZE];
+    atecc608_wake(bus->user_data);
+    readResponse(response);
+}
+
+static void sendWordAddress(uint8_t word) {
+    bus->connect(bus->user_data, bus->address, false);
+    bus->write(bus->user_data, word);
+    bus->disconnect(bus->user_data);
+}
+
+// Sends one command and reads back the response. Returns the first
+// payload byte, the status for a 4-byte response.
+static uint8_t transact(uint8_t opcode, uint8_t p1, uint16_t p2, const uint8_t *data, uint8_t len, uint8_t *response) {
+    uint8_t packet[256];
+    uint8_t count = len + 7;
+    packet[0] = 0x03;
+    packet[1] = count;
+    packet[2] = opcode;
+    packet[3] = p1;
+    packet[4] = p2 & 0xFF;
+    packet[5] = p2 >> 8;
+    if (len) {
+        memcpy(packet + 6, data, len);
+    }
+    uint16_t crc = calculateCRC(packet + 1, count - 2);
+    packet[count - 1] = crc & 0xFF;
+    packet[count] = crc >> 8;
+    bus->connect(bus->user_data, bus->address, false);
+    for (int i = 0; i <= count; i++) {
+        bus->write(bus->user_data, packet[i]);
+    }
+    bus->disconnect(bus->user_data);
+    readResponse(response);
+    return response[1];
+}
+
+// Nonce -> sleep -> Sign, SHA Start -> idle -> Update -> End, and
+// Nonce -> watchdog -> Sign, recorded and then replayed
+static void checkTraceReplay(void) {
+    char dir[] = "/tmp/atecc608-check-XXXXXX";
+    if (!mkdtemp(dir)) {
+        check(false, "trace: scratch directory");
+        return;
+    }
+    setenv("ATECC608_TRACE_DIR", dir, 1);
+    chip_init();
+    unsetenv("ATECC608_TRACE_DIR");
+    bus = host_i2c_device(0);
+    ATECC608 *dev = bus ? bus->user_data : NULL;
+    if (!dev || !dev->trace) {
+        check(false, "trace: chip records a trace");
+        return;
+    }
+
+    uint8_t response[MAX_PACKET_SIZE];
+    uint8_t digest[32] = { 0 };
+    uint8_t message[64];
+    for (int i = 0; i < 64; i++) {
+        message[i] = i;
+    }
+    wakeChip();
+    transact(CMD_GENKEY, GENKEY_MODE_PRIVATE, 2, NULL, 0, response);
+    transact(CMD_NONCE, NONCE_MODE_PASSTHROUGH, 0, digest, 32, response);
+    sendWordAddress(CMD_SLEEP);
+    wakeChip();
+    check(transact(CMD_SIGN, SIGN_MODE_EXTERNAL, 2, NULL, 0, response) == STATUS_EXECUTION_ERROR,
+          "sleep clears TempKey before Sign");
+
+    transact(CMD_SHA, SHA_MODE_START, 0, NULL, 0, response);
+    sendWordAddress(CMD_IDLE);
+    wakeChip();
+    transact(CMD_SHA, SHA_MODE_UPDATE, 0, message, 64, response);
+    uint8_t expected[32];
+    sha256(message, 64, expected);
+    transact(CMD_SHA, SHA_MODE_END, 0, NULL, 0, response);
+    check(response[0] == 35 && memcmp(response + 1, expected, 32) == 0, "idle keeps the SHA context");
+
+    transact(CMD_NONCE, NONCE_MODE_PASSTHROUGH, 0, digest, 32, response);
+    host_advance((uint64_t)(dev->watchdogTimeout + 1) * 1000000);
+    wakeChip();
+    check(transact(CMD_SIGN, SIGN_MODE_EXTERNAL, 2, NULL, 0, response) == STATUS_EXECUTION_ERROR,
+          "watchdog sleep clears TempKey before Sign");
+    atecc608_flush_trace(dev);
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/atecc608-%02x.trace", dir, dev->address);
+    size_t len;
+    uint8_t *data = readFile(path, &len);
+    Trace trace;
+    unsigned long commands = 0, mismatches = 0;
+    ATECC608 *replay = atecc608_create();
+    bool replayed = data && replay && parseTrace(path, data, len, &trace) &&
+                    replayTrace(replay, path, &trace, true, &commands, &mismatches);
+    check(replayed && commands == 8 && mismatches == 0, "trace replays across sleep, idle and watchdog");
+    free(data);
+    remove(path);
+    remove(dir);
+}
+
+// A snapshot whose fields are out of range is refused and resets the device
+static void checkRestoreRange(void) {
+    ATECC608 *dev = atecc608_create();
+    size_t len = atecc608_snapshot_size();
+    uint8_t *good = malloc(len);
+    uint8_t *bad = malloc(len);
+    if (!dev || !good || !bad || !atecc608_snapshot(dev, good, len)) {
+        check(false, "restore: snapshot");
+        free(good);
+        free(bad);
+        return;
+    }
+    const struct {
+        size_t offset;
+        uint8_t value;
+    } fields[] = {
+        { offsetof(ATECC608, state), ACTIVE + 1 },
+        { offsetof(ATECC608, shaContext), SHA_CONTEXT_HMAC + 1 },
+        { offsetof(ATECC608, sha.inner.blockLen), 64 },
+        { offsetof(ATECC608, sha.outer.blockLen), 200 },
+        { offsetof(ATECC608, tempKey.keyId), SLOT_COUNT },
+        { offsetof(ATECC608, tempKey.valid), 2 },
+        { offsetof(ATECC608, gpioLatch), 0xFF },
+    };
+    bool refused = true;
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        memcpy(bad, good, len);
+        bad[sizeof(SnapshotHeader) + fields[i].offset] = fields[i].value;
+        dev->tempKey.valid = true;
+        refused &= !atecc608_restore(dev, bad, len) && dev->state == SLEEP && !dev->tempKey.valid &&
+                   dev->sha.inner.blockLen < 64 && dev->sha.outer.blockLen < 64;
+    }
+    check(refused && atecc608_restore(dev, good, len), "restore refuses out-of-range fields");
+    free(good);
+    free(bad);
+}
+
+// Status of a KDF that writes an HKDF result from the alternate key buffer
+// into a slot
+static uint8_t kdfToSlot(ATECC608 *dev, uint8_t slot) {
+    uint8_t data[4 + 16] = { KDF_DETAILS_HKDF_MSG_LOC_INPUT | KDF_DETAILS_HKDF_ZERO_KEY, 0, 0, 16 };
+    const BatchCommand kdf = {
+        CMD_KDF, KDF_MODE_ALG_HKDF | KDF_MODE_SOURCE_ALTKEYBUF | KDF_MODE_TARGET_SLOT, slot << 8, data, sizeof(data)
+    };
+    uint8_t response[MAX_PACKET_SIZE];
+    atecc608_batch(dev, &kdf, 1, response, sizeof(response), NULL);
+    return response[1];
+}
+
+// Status of an ECDH that writes the shared secret of a TempKey private key
+// into a slot
+static uint8_t ecdhToSlot(ATECC608 *dev, uint8_t slot) {
+    uint8_t private_key[32];
+    uint8_t public_key[64];
+    memset(private_key, 0x11, sizeof(private_key));
+    eccComputePublicKey(private_key, public_key);
+    const BatchCommand commands[] = {
+        { CMD_NONCE, NONCE_MODE_PASSTHROUGH, 0, private_key, 32 },
+        { CMD_ECDH, ECDH_MODE_SOURCE_TEMPKEY | ECDH_MODE_COPY_SLOT, slot, public_key, 64 },
+    };
+    uint8_t response[2 * MAX_PACKET_SIZE];
+    atecc608_batch(dev, commands, 2, response, sizeof(response), NULL);
+    return response[response[0] + 1];
+}
+
+// Makes slot 3 write-never, slot 4 write-always but with its SlotLocked bit
+// cleared, and slot 5 write-always
+static void setSlotPermissions(ATECC608 *dev) {
+    uint8_t slots23[4];     // SlotConfig of slots 2 and 3, config bytes 24-27
+    uint8_t slots45[4] = { 0 };
+    uint8_t slotLocked[4];  // Config bytes 88-91
+    BatchCommand commands[] = {
+        { CMD_READ, ZONE_CONFIG, 6, NULL, 0 },
+        { CMD_READ, ZONE_CONFIG, (2 << 3) | 6, NULL, 0 },
+        { 0 },
+    };
+    uint8_t response[3 * MAX_PACKET_SIZE];  // atecc608_batch() wants room for a full packet per command
+    atecc608_batch(dev, commands, 2, response, sizeof(response), NULL);
+    memcpy(slots23, response + 1, 4);
+    memcpy(slotLocked, response + 8, 4);
+    slots23[2] = 0x00;
+    slots23[3] = 0x80;  // WriteConfig Never
+    slotLocked[0] &= ~(1 << 4);
+    commands[0] = (BatchCommand){ CMD_WRITE, ZONE_CONFIG, 6, slots23, 4 };
+    commands[1] = (BatchCommand){ CMD_WRITE, ZONE_CONFIG, 7, slots45, 4 };
+    commands[2] = (BatchCommand){ CMD_WRITE, ZONE_CONFIG, (2 << 3) | 6, slotLocked, 4 };
+    atecc608_batch(dev, commands, 3, response, sizeof(response), NULL);
+}
+
+static void lockZone(ATECC608 *dev, uint8_t zone) {
+    const BatchCommand lock = { CMD_LOCK, zone | LOCK_MODE_NO_CRC, 0, NULL, 0 };
+    uint8_t response[MAX_PACKET_SIZE];
+    atecc608_batch(dev, &lock, 1, response, sizeof(response), NULL);
+}
+
+// A KDF or ECDH slot target obeys the same rules as Write, see
+// setSlotPermissions()
+static void checkSlotTargets(void) {
+    ATECC608 *dev = atecc608_create();
+    if (!dev) {
+        check(false, "slot targets: device");
+        return;
+    }
+    setSlotPermissions(dev);
+    bool unlocked = kdfToSlot(dev, 3) == STATUS_EXECUTION_ERROR &&  // Config zone not locked yet
+                    ecdhToSlot(dev, 3) == STATUS_EXECUTION_ERROR;
+    lockZone(dev, LOCK_MODE_CONFIG);
+    bool configLocked = kdfToSlot(dev, 3) == STATUS_SUCCESS && kdfToSlot(dev, 4) == STATUS_SUCCESS &&
+                        ecdhToSlot(dev, 3) == STATUS_SUCCESS && ecdhToSlot(dev, 4) == STATUS_SUCCESS;
+    lockZone(dev, LOCK_MODE_DATA);
+    bool dataLocked = isDataAndOTPLocked(dev);
+    check(unlocked && configLocked && dataLocked && kdfToSlot(dev, 3) == STATUS_EXECUTION_ERROR &&
+              kdfToSlot(dev, 4) == STATUS_EXECUTION_ERROR && kdfToSlot(dev, 5) == STATUS_SUCCESS,
+          "kdf slot target follows the write permissions");
+    check(unlocked && configLocked && dataLocked && ecdhToSlot(dev, 3) == STATUS_EXECUTION_ERROR &&
+              ecdhToSlot(dev, 4) == STATUS_EXECUTION_ERROR && ecdhToSlot(dev, 5) == STATUS_SUCCESS,
+          "ecdh slot target follows the write permissions");
+}
+
+int main(void) {
+    unsetenv("ATECC608_EEPROM_DIR");
+    checkTraceReplay();
+    checkRestoreRange();
+    checkSlotTargets();
+    printf("%s\n", failures ? "FAILED" : "all checks passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,123 @@
+// Fuzzing entry point for the ATECC608 command path, for libFuzzer or AFL++
+// persistent mode, plus a plain driver that replays saved inputs.
+//
+// Build from the repository root:
+//   libFuzzer:  clang -g -O1 -fsanitize=fuzzer,address,undefined -Itools
+//                   tools/atecc608-fuzz.c tools/wokwi-host.c -o atecc608-fuzz
+//   AFL++:      afl-clang-fast -g -O2 -DATECC608_FUZZ_MAIN -Itools
+//                   tools/atecc608-fuzz.c tools/wokwi-host.c -o atecc608-fuzz-afl
+//               afl-fuzz -i seeds -o findings -- ./atecc608-fuzz-afl
+//   replay:     cc -g -O1 -fsanitize=address,undefined -DATECC608_FUZZ_MAIN -Itools
+//                   tools/atecc608-fuzz.c tools/wokwi-host.c -o atecc608-fuzz-run
+//               ./atecc608-fuzz-run crash-file...
+//
+// An input is a flags byte followed by bus writes, each a length byte and
+// that many bytes (the last write takes whatever is left). Every write goes
+// through atecc608_execute(), word address first. Flags:
+//   FUZZ_FIX_CRC  patch the CRC of every command packet so the fuzzer gets
+//                 past the CRC check without having to solve it
+//   FUZZ_LOCKED   start from the provisioned, fully locked device instead
+//                 of a factory fresh one
+// Both starting states are snapshots taken once, so the reset between
+// inputs is a memcpy rather than atecc608_init().
+#include "../chip-atecc608/atecc608.c"
+
+#define FUZZ_FIX_CRC 0x01
+#define FUZZ_LOCKED 0x02
+
+static ATECC608 *fuzzDevice;
+static uint8_t freshSnapshot[SNAPSHOT_SIZE];
+static uint8_t lockedSnapshot[SNAPSHOT_SIZE];
+
+// Gives the locked state a key pair in slot 0, data in slot 8 and SecureBoot
+// enabled with a stored digest in slot 9, so Sign, GenKey, Read and
+// SecureBoot have something to work on
+static void provision(ATECC608 *dev) {
+    static const uint8_t data[32] = { 0x5A };
+    static const uint8_t secure_boot[4] = { 0, 0, SECUREBOOT_CONFIG_FULL_DIG, 0x89 };  // Config bytes 68-71
+    const BatchCommand commands[] = {
+        { CMD_WRITE, ZONE_CONFIG, (2 << 3) | 1, secure_boot, sizeof(secure_boot) },
+        { CMD_LOCK, LOCK_MODE_NO_CRC | LOCK_MODE_CONFIG, 0, NULL, 0 },
+        { CMD_GENKEY, 0x04, 0, NULL, 0 },
+        { CMD_WRITE, ZONE_DATA | ZONE_MODE_32_BYTES, 8 << 3, data, sizeof(data) },
+        { CMD_LOCK, LOCK_MODE_NO_CRC | LOCK_MODE_DATA, 0, NULL, 0 },
+    };
+    uint8_t responses[sizeof(commands) / sizeof(commands[0]) * MAX_PACKET_SIZE];
+    atecc608_batch(dev, commands, sizeof(commands) / sizeof(commands[0]), responses, sizeof(responses), NULL);
+}
+
+static void fuzzInit(void) {
+    unsetenv("ATECC608_EEPROM_DIR");
+    unsetenv("ATECC608_TRACE_DIR");
+    setenv("WOKWI_ATTR_seed", "1", 0);
+    fuzzDevice = atecc608_create();
+    if (!fuzzDevice) {
+        abort();
+    }
+    atecc608_snapshot(fuzzDevice, freshSnapshot, sizeof(freshSnapshot));
+    provision(fuzzDevice);
+    atecc608_snapshot(fuzzDevice, lockedSnapshot, sizeof(lockedSnapshot));
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *input, size_t size) {
+    if (!fuzzDevice) {
+        fuzzInit();
+    }
+    if (size == 0) {
+        return 0;
+    }
+    uint8_t flags = input[0];
+    atecc608_restore(fuzzDevice, flags & FUZZ_LOCKED ? lockedSnapshot : freshSnapshot, sizeof(freshSnapshot));
+
+    size_t pos = 1;
+    while (pos < size) {
+        size_t len = input[pos++];
+        if (len > size - pos) {
+            len = size - pos;
+        }
+        uint8_t packet[256];
+        memcpy(packet, input + pos, len);
+        pos += len;
+        if ((flags & FUZZ_FIX_CRC) && len >= 8 && packet[0] == CMD_COMMAND &&
+            packet[1] >= 7 && packet[1] < len) {
+            uint16_t crc = calculateCRC(packet + 1, packet[1] - 2);
+            packet[packet[1] - 1] = crc & 0xFF;
+            packet[packet[1]] = crc >> 8;
+        }
+        uint8_t response[MAX_PACKET_SIZE];
+        atecc608_execute(fuzzDevice, packet, len, response, sizeof(response));
+    }
+    return 0;
+}
+
+#ifdef ATECC608_FUZZ_MAIN
+#ifdef __AFL_FUZZ_TESTCASE_LEN
+__AFL_FUZZ_INIT();
+#endif
+
+int main(int argc, char **argv) {
+    fuzzInit();
+#ifdef __AFL_FUZZ_TESTCASE_LEN
+    __AFL_INIT();
+    const uint8_t *buf = __AFL_FUZZ_TESTCASE_BUF;
+    while (__AFL_LOOP(100000)) {
+        LLVMFuzzerTestOneInput(buf, __AFL_FUZZ_TESTCASE_LEN);
+    }
+#else
+    static uint8_t buf[1 << 16];
+    for (int i = 1; i < argc || i == 1; i++) {
+        FILE *f = i < argc ? fopen(argv[i], "rb") : stdin;
+        if (!f) {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            return 1;
+        }
+        size_t len = fread(buf, 1, sizeof(buf), f);
+        if (f != stdin) {
+            fclose(f);
+        }
+        LLVMFuzzerTestOneInput(buf, len);
+    }
+#endif
+    return 0;
+}
+#endif
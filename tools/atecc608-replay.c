@@ -0,0 +1,193 @@
+// Replays a command trace recorded by the ATECC608 chip (see traceOpen() in
+// chip-atecc608/atecc608.c) against the simulator core at full host speed,
+// checking every response against the recorded one. Power events (sleep,
+// idle, watchdog, wake) are applied where they were recorded, so commands
+// that depend on what sleep clears replay the way they ran.
+//
+// Build from the repository root:
+//   cc -O2 -Itools tools/atecc608-replay.c tools/wokwi-host.c -o atecc608-replay
+// Run:
+//   ./atecc608-replay atecc608-60.trace [iterations]
+//
+// Each iteration restores the snapshot stored in the trace header, so runs
+// are deterministic and repeatable. Attributes such as latencyProfile can be
+// set through WOKWI_ATTR_<name>, see tools/wokwi-host.c.
+//
+// Define ATECC608_REPLAY_NO_MAIN to use parseTrace() and replayTrace() from
+// another tool, as tools/atecc608-check.c does.
+#include "../chip-atecc608/atecc608.c"
+
+static uint8_t *readFile(const char *path, size_t *len) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *buf = size > 0 ? malloc(size) : NULL;
+    if (buf && fread(buf, 1, size, f) != (size_t)size) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *len = buf ? (size_t)size : 0;
+    return buf;
+}
+
+// Applies a TRACE_EVENT_* record. Wakes only start here; the next command
+// finishes them, as atecc608_execute() readies the chip for the host.
+static void replayEvent(ATECC608 *dev, uint8_t event) {
+    switch (event) {
+        case TRACE_EVENT_RESET:
+            dev->responsePos = 0;
+            break;
+        case TRACE_EVENT_SLEEP:
+        case TRACE_EVENT_WATCHDOG:
+            powerDown(dev, SLEEP);
+            break;
+        case TRACE_EVENT_IDLE:
+            powerDown(dev, IDLE);
+            break;
+        case TRACE_EVENT_WAKE:
+            atecc608_wake(dev);
+            break;
+    }
+}
+
+// Where the parts of a trace file are
+typedef struct {
+    const uint8_t *data;  // Whole file, for offsets in messages
+    const uint8_t *snapshot;
+    size_t snapshotLen;
+    const uint8_t *records;
+    const uint8_t *end;
+} Trace;
+
+// Checks the header of the trace in data; name is only used in messages
+static bool parseTrace(const char *name, const uint8_t *data, size_t len, Trace *trace) {
+    if (len < 10 || loadLe32(data) != TRACE_MAGIC || (data[4] | data[5] << 8) != TRACE_VERSION) {
+        fprintf(stderr, "%s: not an ATECC608 trace\n", name);
+        return false;
+    }
+    size_t snapshot_len = loadLe32(data + 6);
+    if (10 + snapshot_len > len) {
+        fprintf(stderr, "%s: truncated snapshot\n", name);
+        return false;
+    }
+    trace->data = data;
+    trace->snapshot = data + 10;
+    trace->snapshotLen = snapshot_len;
+    trace->records = trace->snapshot + snapshot_len;
+    trace->end = data + len;
+    return true;
+}
+
+// Restores the trace's snapshot into dev and replays every record once,
+// adding to *commands and *mismatches. Mismatches are printed when report
+// is set. Returns false if the trace cannot be replayed.
+static bool replayTrace(ATECC608 *dev, const char *name, const Trace *trace, bool report,
+                        unsigned long *commands, unsigned long *mismatches) {
+    if (!atecc608_restore(dev, trace->snapshot, trace->snapshotLen)) {
+        fprintf(stderr, "%s: snapshot does not match this build\n", name);
+        return false;
+    }
+    memset(&dev->stats, 0, sizeof(dev->stats));
+
+    const uint8_t *p = trace->records;
+    const uint8_t *end = trace->end;
+    while (p < end) {
+        // u64 time, then count + packet, response count + response, or
+        // a 0 count and a power event
+        if (end - p >= 10 && p[8] == 0) {
+            replayEvent(dev, p[9]);
+            p += 10;
+            continue;
+        }
+        if (end - p < 10 || p[8] < 7 || end - p < 8 + p[8] + 1) {
+            fprintf(stderr, "%s: truncated record at offset %ld\n", name, (long)(p - trace->data));
+            return false;
+        }
+        uint64_t when = 0;
+        for (int i = 7; i >= 0; i--) {
+            when = when << 8 | p[i];
+        }
+        uint8_t packet[256];
+        uint8_t count = p[8];
+        packet[0] = 0x03;
+        memcpy(packet + 1, p + 8, count);
+        const uint8_t *expected = p + 8 + count;
+        size_t expected_len = expected[0] ? expected[0] : 1;
+        if (end - expected < (long)expected_len) {
+            fprintf(stderr, "%s: truncated record at offset %ld\n", name, (long)(p - trace->data));
+            return false;
+        }
+        p = expected + expected_len;
+
+        uint8_t response[MAX_PACKET_SIZE];
+        size_t response_len = atecc608_execute(dev, packet, count + 1, response, sizeof(response));
+        (*commands)++;
+        if (expected[0] != response_len ||
+            memcmp(response, expected, response_len) != 0) {
+            (*mismatches)++;
+            if (report) {
+                printf("mismatch: opcode 0x%02X at %llu ns\n", packet[2], (unsigned long long)when);
+            }
+        }
+    }
+    return true;
+}
+
+#ifndef ATECC608_REPLAY_NO_MAIN
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s TRACE [iterations]\n", argv[0]);
+        return 2;
+    }
+    int iterations = argc > 2 ? atoi(argv[2]) : 1;
+    if (iterations < 1) {
+        iterations = 1;
+    }
+
+    size_t trace_len;
+    uint8_t *data = readFile(argv[1], &trace_len);
+    if (!data) {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+    Trace trace;
+    if (!parseTrace(argv[1], data, trace_len, &trace)) {
+        return 1;
+    }
+
+    // The replay must neither touch the recorded EEPROM image nor record
+    // a trace of its own
+    unsetenv("ATECC608_EEPROM_DIR");
+    unsetenv("ATECC608_TRACE_DIR");
+    ATECC608 *dev = atecc608_create();
+    if (!dev) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    unsigned long commands = 0, mismatches = 0;
+    uint64_t host_ns = 0;
+    for (int iter = 0; iter < iterations; iter++) {
+        uint64_t start = hostNanos();
+        if (!replayTrace(dev, argv[1], &trace, iter == 0, &commands, &mismatches)) {
+            return 1;
+        }
+        host_ns += hostNanos() - start;
+    }
+
+    printf("%lu commands, %lu mismatches, %.3f ms host time",
+           commands, mismatches, host_ns / 1e6);
+    if (host_ns) {
+        printf(", %.0f commands/s", commands * 1e9 / host_ns);
+    }
+    printf("\n");
+    atecc608_dump_stats(dev);
+    free(data);
+    return mismatches ? 1 : 0;
+}
+#endif
@@ -0,0 +1,62 @@
+// Host-side stand-in for the Wokwi chip API, declaring just what
+// chip-atecc608/atecc608.c uses so it can be built into command-line tools.
+// The definitions live in wokwi-host.c.
+#ifndef WOKWI_HOST_API_H
+#define WOKWI_HOST_API_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef int32_t pin_t;
+#define NO_PIN ((pin_t)-1)
+
+enum { INPUT = 0, OUTPUT = 1, INPUT_PULLUP = 2, INPUT_PULLDOWN = 3, ANALOG = 4, OUTPUT_LOW = 16, OUTPUT_HIGH = 17 };
+enum { LOW = 0, HIGH = 1 };
+enum { RISING = 1, FALLING = 2, BOTH = 3 };
+
+typedef struct {
+    void *user_data;
+    uint32_t edge;
+    void (*pin_change)(void *user_data, pin_t pin, uint32_t value);
+} pin_watch_config_t;
+
+typedef struct {
+    void *user_data;
+    void (*callback)(void *user_data);
+} timer_config_t;
+
+typedef struct {
+    void *user_data;
+    uint32_t address;
+    pin_t scl;
+    pin_t sda;
+    bool (*connect)(void *user_data, uint32_t address, bool read);
+    uint8_t (*read)(void *user_data);
+    bool (*write)(void *user_data, uint8_t data);
+    void (*disconnect)(void *user_data);
+    uint32_t reserved[8];
+} i2c_config_t;
+
+pin_t pin_init(const char *name, uint32_t mode);
+uint32_t pin_read(pin_t pin);
+void pin_write(pin_t pin, uint32_t value);
+void pin_mode(pin_t pin, uint32_t value);
+bool pin_watch(pin_t pin, const pin_watch_config_t *config);
+void pin_watch_stop(pin_t pin);
+
+uint32_t attr_init(const char *name, uint32_t default_value);
+uint32_t attr_read(uint32_t attr_id);
+
+uint32_t timer_init(const timer_config_t *config);
+void timer_start(uint32_t timer_id, uint32_t micros, bool repeat);
+void timer_start_ns(uint32_t timer_id, uint64_t nanos, bool repeat);
+void timer_stop(uint32_t timer_id);
+uint64_t get_sim_nanos(void);
+
+uint32_t i2c_init(const i2c_config_t *config);
+
+// Host extensions
+const i2c_config_t *host_i2c_device(uint32_t index);
+void host_advance(uint64_t nanos);  // Moves simulated time, firing due timers
+
+#endif
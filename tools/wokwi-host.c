@@ -0,0 +1,136 @@
+// Minimal Wokwi chip API for running atecc608.c on the host.
+//
+// Attributes come from WOKWI_ATTR_<name> environment variables (falling
+// back to the default). Simulated time only moves in host_advance(), which
+// fires the timers that fall due on the way, so a tool decides how much
+// time passes between bus transactions. A repeating timer is rearmed after
+// each callback; one with a zero period fires once and stops rather than
+// looping forever.
+#include "wokwi-api.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HOST_MAX_ATTRS 64
+#define HOST_MAX_TIMERS 64
+#define HOST_MAX_I2C 16
+
+static uint32_t attrValues[HOST_MAX_ATTRS];
+static uint32_t attrCount;
+typedef struct {
+    timer_config_t config;
+    bool armed;
+    bool repeat;
+    uint64_t due;
+    uint64_t period;
+} HostTimer;
+
+static HostTimer timers[HOST_MAX_TIMERS];
+static uint32_t timerCount;
+static i2c_config_t i2cDevices[HOST_MAX_I2C];
+static uint32_t i2cCount;
+static uint64_t simNanos;
+
+pin_t pin_init(const char *name, uint32_t mode) {
+    return NO_PIN;
+}
+
+uint32_t pin_read(pin_t pin) {
+    return HIGH;
+}
+
+void pin_write(pin_t pin, uint32_t value) {
+}
+
+void pin_mode(pin_t pin, uint32_t value) {
+}
+
+bool pin_watch(pin_t pin, const pin_watch_config_t *config) {
+    return true;
+}
+
+void pin_watch_stop(pin_t pin) {
+}
+
+uint32_t attr_init(const char *name, uint32_t default_value) {
+    char key[96];
+    snprintf(key, sizeof(key), "WOKWI_ATTR_%s", name);
+    const char *value = getenv(key);
+    uint32_t id = attrCount < HOST_MAX_ATTRS ? attrCount++ : HOST_MAX_ATTRS - 1;
+    attrValues[id] = value ? (uint32_t)strtoul(value, NULL, 0) : default_value;
+    return id;
+}
+
+uint32_t attr_read(uint32_t attr_id) {
+    return attr_id < HOST_MAX_ATTRS ? attrValues[attr_id] : 0;
+}
+
+uint32_t timer_init(const timer_config_t *config) {
+    if (timerCount == HOST_MAX_TIMERS) {
+        fprintf(stderr, "wokwi-host: out of timers\n");
+        exit(1);
+    }
+    timers[timerCount].config = *config;
+    return timerCount++;
+}
+
+void timer_start_ns(uint32_t timer_id, uint64_t nanos, bool repeat) {
+    if (timer_id >= timerCount) {
+        return;
+    }
+    HostTimer *timer = &timers[timer_id];
+    timer->armed = true;
+    timer->repeat = repeat;
+    timer->period = nanos;
+    timer->due = simNanos + nanos;
+}
+
+void timer_start(uint32_t timer_id, uint32_t micros, bool repeat) {
+    timer_start_ns(timer_id, (uint64_t)micros * 1000, repeat);
+}
+
+void timer_stop(uint32_t timer_id) {
+    if (timer_id < timerCount) {
+        timers[timer_id].armed = false;
+    }
+}
+
+void host_advance(uint64_t nanos) {
+    uint64_t end = simNanos + nanos;
+    for (;;) {
+        HostTimer *next = NULL;
+        for (uint32_t i = 0; i < timerCount; i++) {
+            if (timers[i].armed && timers[i].due <= end && (!next || timers[i].due < next->due)) {
+                next = &timers[i];
+            }
+        }
+        if (!next) {
+            break;
+        }
+        simNanos = next->due;
+        if (next->repeat && next->period) {
+            next->due += next->period;
+        } else {
+            next->armed = false;
+        }
+        next->config.callback(next->config.user_data);
+    }
+    simNanos = end;
+}
+
+uint64_t get_sim_nanos(void) {
+    return simNanos;
+}
+
+uint32_t i2c_init(const i2c_config_t *config) {
+    if (i2cCount == HOST_MAX_I2C) {
+        fprintf(stderr, "wokwi-host: out of I2C devices\n");
+        exit(1);
+    }
+    i2cDevices[i2cCount] = *config;
+    return i2cCount++;
+}
+
+const i2c_config_t *host_i2c_device(uint32_t index) {
+    return index < i2cCount ? &i2cDevices[index] : NULL;
+}